@@ -0,0 +1,248 @@
+// Branch predictors used to find mispredicted branches. With flushing on, a mispredict
+// empties the ROB window (see branchResolve); run with and without it to compare
+// forwarding with and without misprediction effects. All state is fixed-size tables,
+// about 32KB with TAGE: 4KB of base counters, 12KB of tagged entries, a 16KB BTB of
+// full pc/target pairs and a 16-entry return stack. Include after RobEngine.h.
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include <string>
+
+// bpKind: which predictor drives direction predictions
+#define BP_NONE 0
+#define BP_BIMODAL 1
+#define BP_GSHARE 2
+#define BP_TAGE 3
+
+#define BP_COUNTER_BITS 12
+#define BP_COUNTERS (1 << BP_COUNTER_BITS)
+#define BTB_BITS 10
+#define BTB_ENTRIES (1 << BTB_BITS)
+#define TAGE_TABLES 3
+#define TAGE_BITS 10
+#define TAGE_ENTRIES (1 << TAGE_BITS)
+#define TAGE_TAG_BITS 9
+// Halve every useful counter this often so stale entries can be replaced
+#define TAGE_RESET_PERIOD (1 << 18)
+// Return stack; deeper call chains wrap and overwrite the oldest entries
+#define RAS_ENTRIES 16
+
+struct tageEntry {
+    UINT16 tag = 0;
+    // 3-bit signed counter, taken when >= 0
+    INT8 ctr = 0;
+    UINT8 useful = 0;
+};
+
+struct btbEntry {
+    ADDRINT pc = 0;
+    ADDRINT target = 0;
+};
+
+static int bpKind = BP_NONE;
+// Whether a mispredict flushes the ROB window
+static bool bpFlush = false;
+static UINT64 branchCount = 0;
+static UINT64 mispredictCount = 0;
+// Global history, newest outcome in bit 0
+static UINT64 bpHistory = 0;
+// 2-bit saturating counters, taken when >= 2. Bimodal/gshare table and TAGE base.
+static UINT8 bpCounters[BP_COUNTERS];
+static tageEntry tage[TAGE_TABLES][TAGE_ENTRIES];
+static const UINT32 tageHistoryLength[TAGE_TABLES] = { 5, 15, 44 };
+static btbEntry btb[BTB_ENTRIES];
+static ADDRINT ras[RAS_ENTRIES];
+// Pushes minus pops; the top entry is ras[(rasDepth - 1) % RAS_ENTRIES]
+static UINT32 rasDepth = 0;
+
+int bpKindFromName(const std::string& name) {
+    if (name == "bimodal") {
+        return BP_BIMODAL;
+    }
+    if (name == "gshare") {
+        return BP_GSHARE;
+    }
+    if (name == "tage") {
+        return BP_TAGE;
+    }
+    return BP_NONE;
+}
+
+VOID bpReset(int kind, bool flush) {
+    bpKind = kind;
+    bpFlush = flush;
+    branchCount = 0;
+    mispredictCount = 0;
+    bpHistory = 0;
+    for (UINT32 i = 0; i < BP_COUNTERS; i++) {
+        // weakly taken
+        bpCounters[i] = 2;
+    }
+    for (UINT32 t = 0; t < TAGE_TABLES; t++) {
+        for (UINT32 i = 0; i < TAGE_ENTRIES; i++) {
+            tage[t][i] = tageEntry();
+        }
+    }
+    for (UINT32 i = 0; i < BTB_ENTRIES; i++) {
+        btb[i] = btbEntry();
+    }
+    for (UINT32 i = 0; i < RAS_ENTRIES; i++) {
+        ras[i] = 0;
+    }
+    rasDepth = 0;
+}
+
+// XOR-fold the newest len history bits down to bits bits
+UINT32 bpFoldHistory(UINT32 len, UINT32 bits) {
+    UINT64 h = (len >= 64) ? bpHistory : (bpHistory & ((1ULL << len) - 1));
+    UINT32 folded = 0;
+    while (h != 0) {
+        folded ^= (UINT32)(h & ((1U << bits) - 1));
+        h >>= bits;
+    }
+    return folded;
+}
+
+UINT32 tageIndex(UINT32 t, ADDRINT pc) {
+    return (UINT32)(pc ^ (pc >> TAGE_BITS) ^ bpFoldHistory(tageHistoryLength[t], TAGE_BITS)) & (TAGE_ENTRIES - 1);
+}
+
+UINT16 tageTag(UINT32 t, ADDRINT pc) {
+    return (UINT16)((pc ^ (bpFoldHistory(tageHistoryLength[t], TAGE_TAG_BITS) << 1)) & ((1 << TAGE_TAG_BITS) - 1));
+}
+
+VOID bpCounterUpdate(UINT8& ctr, bool taken) {
+    if (taken && ctr < 3) {
+        ctr++;
+    } else if (!taken && ctr > 0) {
+        ctr--;
+    }
+}
+
+// Predict and train on one conditional branch; true when the direction was mispredicted
+bool tagePredictAndUpdate(ADDRINT pc, bool taken) {
+    UINT32 idx[TAGE_TABLES];
+    UINT16 tag[TAGE_TABLES];
+    int provider = -1;
+    int alt = -1;
+    for (int t = TAGE_TABLES - 1; t >= 0; t--) {
+        idx[t] = tageIndex(t, pc);
+        tag[t] = tageTag(t, pc);
+        if (tage[t][idx[t]].tag == tag[t]) {
+            if (provider < 0) {
+                provider = t;
+            } else if (alt < 0) {
+                alt = t;
+            }
+        }
+    }
+
+    UINT8& base = bpCounters[pc & (BP_COUNTERS - 1)];
+    bool altPred = (alt >= 0) ? tage[alt][idx[alt]].ctr >= 0 : base >= 2;
+    bool pred = (provider >= 0) ? tage[provider][idx[provider]].ctr >= 0 : altPred;
+
+    if (provider >= 0) {
+        tageEntry& e = tage[provider][idx[provider]];
+        if (pred != altPred) {
+            if (pred == taken && e.useful < 3) {
+                e.useful++;
+            } else if (pred != taken && e.useful > 0) {
+                e.useful--;
+            }
+        }
+        if (taken && e.ctr < 3) {
+            e.ctr++;
+        } else if (!taken && e.ctr > -4) {
+            e.ctr--;
+        }
+    } else {
+        bpCounterUpdate(base, taken);
+    }
+
+    // On a mispredict take a free entry in a longer-history table, else age the candidates
+    if (pred != taken && provider < TAGE_TABLES - 1) {
+        bool allocated = false;
+        for (int t = provider + 1; t < TAGE_TABLES && !allocated; t++) {
+            if (tage[t][idx[t]].useful == 0) {
+                tage[t][idx[t]].tag = tag[t];
+                tage[t][idx[t]].ctr = taken ? 0 : -1;
+                allocated = true;
+            }
+        }
+        for (int t = provider + 1; t < TAGE_TABLES && !allocated; t++) {
+            tage[t][idx[t]].useful--;
+        }
+    }
+    if (branchCount % TAGE_RESET_PERIOD == 0) {
+        for (UINT32 t = 0; t < TAGE_TABLES; t++) {
+            for (UINT32 i = 0; i < TAGE_ENTRIES; i++) {
+                tage[t][i].useful >>= 1;
+            }
+        }
+    }
+    return pred != taken;
+}
+
+bool bpDirectionMispredicted(ADDRINT pc, bool taken) {
+    if (bpKind == BP_TAGE) {
+        return tagePredictAndUpdate(pc, taken);
+    }
+    UINT32 i = (UINT32)pc;
+    if (bpKind == BP_GSHARE) {
+        i ^= (UINT32)bpHistory;
+    }
+    UINT8& ctr = bpCounters[i & (BP_COUNTERS - 1)];
+    bool pred = ctr >= 2;
+    bpCounterUpdate(ctr, taken);
+    return pred != taken;
+}
+
+// Taken branches also need the right target from the BTB
+bool btbMispredicted(ADDRINT pc, ADDRINT target) {
+    btbEntry& e = btb[pc & (BTB_ENTRIES - 1)];
+    bool miss = e.pc != pc || e.target != target;
+    e.pc = pc;
+    e.target = target;
+    return miss;
+}
+
+// Calls push their return address
+VOID rasPush(ADDRINT returnAddr) {
+    ras[rasDepth % RAS_ENTRIES] = returnAddr;
+    rasDepth++;
+}
+
+// Returns are predicted from the stack rather than the BTB, which would miss on every
+// return to a different caller than last time
+bool rasMispredicted(ADDRINT target) {
+    if (rasDepth == 0) {
+        return true;
+    }
+    rasDepth--;
+    return ras[rasDepth % RAS_ENTRIES] != target;
+}
+
+// Called after the branch itself went through the ROB model. A mispredict flushes
+// everything younger, so nothing up to and including the branch forwards past it;
+// with bpFlush the ROB is emptied to match.
+VOID branchResolve(ADDRINT pc, BOOL taken, ADDRINT target, BOOL conditional, BOOL isReturn) {
+    branchCount++;
+    bool mispredicted = false;
+    if (conditional) {
+        mispredicted = bpDirectionMispredicted(pc, taken);
+        bpHistory = (bpHistory << 1) | (taken ? 1 : 0);
+    }
+    if (isReturn) {
+        mispredicted = rasMispredicted(target);
+    } else if (taken && btbMispredicted(pc, target)) {
+        mispredicted = true;
+    }
+    if (mispredicted) {
+        mispredictCount++;
+        if (bpFlush) {
+            robFlush();
+        }
+    }
+}
+
+#endif
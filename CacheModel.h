@@ -0,0 +1,139 @@
+// Two-level set-associative data cache model fed with dynamic effective
+// addresses. Each set keeps its tags in a fixed CACHE_WAY_LANES-wide UINT32 array
+// (unused ways hold 0, which no tag equals), so a lookup is one branch-free compare
+// over the whole row that the compiler vectorizes. LRU state is one age byte per
+// way. Include after RobEngine.h.
+#ifndef CACHE_MODEL_H
+#define CACHE_MODEL_H
+
+#define CACHE_LINE_SHIFT 6
+#define CACHE_WAY_LANES 16
+#define CACHE_MAX_SETS 4096
+// Lanes beyond the configured associativity never age into the victim slot
+#define CACHE_AGE_UNUSED 0xFF
+
+// Levels a load is served from
+#define LEVEL_L1 0
+#define LEVEL_L2 1
+#define LEVEL_MEM 2
+// Shared with the engine, which weights ROB forwards from loads by these levels
+#define CACHE_LEVELS ROB_LOAD_LEVELS
+
+static const UINT32 levelLatency[CACHE_LEVELS] = { 4, 12, 200 };
+static const char* const levelName[CACHE_LEVELS] = { "L1", "L2", "memory" };
+
+struct cacheLevel {
+    UINT32 sets = 0;
+    UINT32 ways = 0;
+    UINT32 setShift = 0;
+    UINT32* tags = NULL;
+    UINT8* ages = NULL;
+};
+
+// Set by cacheReset, which is only called when the cache is modelled
+static bool cacheEnabled = false;
+static cacheLevel l1Cache;
+static cacheLevel l2Cache;
+static UINT64 loadsByLevel[CACHE_LEVELS];
+static UINT64 storesByLevel[CACHE_LEVELS];
+// Store-to-load forwards, by the level the store found its line in before filling
+// it: where the load would have gone had the store not brought the line in
+static UINT64 stlfByLevel[CACHE_LEVELS];
+
+UINT32 log2Floor(UINT32 v) {
+    UINT32 r = 0;
+    while (v >>= 1) {
+        r++;
+    }
+    return r;
+}
+
+// size in KB; sets are rounded down to a power of two
+VOID cacheInit(cacheLevel& c, UINT32 sizeKB, UINT32 ways) {
+    c.ways = std::min(std::max(ways, 1U), (UINT32)CACHE_WAY_LANES);
+    UINT32 sets = std::max((sizeKB * 1024) >> CACHE_LINE_SHIFT, 1U) / c.ways;
+    c.setShift = log2Floor(std::min(std::max(sets, 1U), (UINT32)CACHE_MAX_SETS));
+    c.sets = 1 << c.setShift;
+    delete[] c.tags;
+    delete[] c.ages;
+    c.tags = new UINT32[c.sets * CACHE_WAY_LANES];
+    c.ages = new UINT8[c.sets * CACHE_WAY_LANES];
+    for (UINT32 s = 0; s < c.sets; s++) {
+        for (UINT32 w = 0; w < CACHE_WAY_LANES; w++) {
+            c.tags[s * CACHE_WAY_LANES + w] = 0;
+            c.ages[s * CACHE_WAY_LANES + w] = (w < c.ways) ? w : CACHE_AGE_UNUSED;
+        }
+    }
+}
+
+VOID cacheReset(UINT32 l1KB, UINT32 l1Ways, UINT32 l2KB, UINT32 l2Ways) {
+    cacheEnabled = true;
+    cacheInit(l1Cache, l1KB, l1Ways);
+    cacheInit(l2Cache, l2KB, l2Ways);
+    for (UINT32 l = 0; l < CACHE_LEVELS; l++) {
+        loadsByLevel[l] = 0;
+        storesByLevel[l] = 0;
+        stlfByLevel[l] = 0;
+    }
+}
+
+UINT32 cacheSetOf(const cacheLevel& c, ADDRINT addr) {
+    return (UINT32)(addr >> CACHE_LINE_SHIFT) & (c.sets - 1);
+}
+
+UINT32 cacheTagOf(const cacheLevel& c, ADDRINT addr) {
+    UINT64 t = (addr >> CACHE_LINE_SHIFT) >> c.setShift;
+    // 31-bit partial tag with the top bit set, so it never matches an empty way
+    return ((UINT32)(t ^ (t >> 31)) & 0x7FFFFFFF) | 0x80000000;
+}
+
+// Ways of the set holding addr's line, one bit per lane
+UINT32 cacheHitMask(const cacheLevel& c, ADDRINT addr) {
+    UINT32 tag = cacheTagOf(c, addr);
+    const UINT32* tags = c.tags + cacheSetOf(c, addr) * CACHE_WAY_LANES;
+    UINT32 hitMask = 0;
+    for (UINT32 w = 0; w < CACHE_WAY_LANES; w++) {
+        hitMask |= (UINT32)(tags[w] == tag) << w;
+    }
+    return hitMask;
+}
+
+// Access one level, filling on a miss; true on a hit
+bool cacheLookup(cacheLevel& c, ADDRINT addr) {
+    UINT32 set = cacheSetOf(c, addr);
+    UINT32* tags = c.tags + set * CACHE_WAY_LANES;
+    UINT8* ages = c.ages + set * CACHE_WAY_LANES;
+    UINT32 hitMask = cacheHitMask(c, addr);
+
+    UINT32 way;
+    if (hitMask != 0) {
+        way = __builtin_ctz(hitMask);
+    } else {
+        // LRU victim has the largest age among the real ways
+        UINT32 victimMask = 0;
+        for (UINT32 w = 0; w < CACHE_WAY_LANES; w++) {
+            victimMask |= (UINT32)(ages[w] == c.ways - 1) << w;
+        }
+        way = __builtin_ctz(victimMask);
+        tags[way] = cacheTagOf(c, addr);
+    }
+    UINT8 age = ages[way];
+    for (UINT32 w = 0; w < CACHE_WAY_LANES; w++) {
+        ages[w] += (ages[w] < age) ? 1 : 0;
+    }
+    ages[way] = 0;
+    return hitMask != 0;
+}
+
+// Level the access is served from; misses fill both levels
+UINT32 cacheAccess(ADDRINT addr) {
+    if (cacheLookup(l1Cache, addr)) {
+        return LEVEL_L1;
+    }
+    if (cacheLookup(l2Cache, addr)) {
+        return LEVEL_L2;
+    }
+    return LEVEL_MEM;
+}
+
+#endif
@@ -0,0 +1,209 @@
+// Lookahead scheduler: an alternative to the greedy per-instruction policy. It
+// buffers K instructions, builds their RAW dependence DAG and places the whole
+// batch at once by list scheduling: each step takes the ready instruction that
+// picks up the most bypasses from the last FORWARD_DISTANCE placed entries,
+// while each producer feeds at most BYPASS_CAPACITY consumers. Scheduling a batch
+// costs O(K) per instruction, no more than the greedy ROB scan.
+// This is a heuristic with its own forward rule (distance and capacity within a
+// batch plus LA_CARRY carried entries), not the optimum, and the greedy ROB counts
+// forwards by different rules over a BUFFER_SIZE window. Its count is a second
+// model to compare against, not a bound on what greedy could reach.
+// Include after RobEngine.h.
+#ifndef LOOKAHEAD_SCHEDULER_H
+#define LOOKAHEAD_SCHEDULER_H
+
+#define LOOKAHEAD_MAX 256
+// A consumer placed within this many entries after its producer is forwarded
+#define FORWARD_DISTANCE 3
+#define BYPASS_CAPACITY 3
+// Distinct producers kept per instruction
+#define LA_MAX_PREDS 8
+// Producers from the previous batch that can still reach this one: its last FORWARD_DISTANCE placed entries
+#define LA_CARRY FORWARD_DISTANCE
+#define LA_NONE 0xFFFF
+
+static UINT32 lookaheadSize = 0;
+static const insInfo* laBatch[LOOKAHEAD_MAX];
+static UINT32 laCount = 0;
+// Sequence numbers local to the scheduler; laSeq is the last one handed out
+static UINT64 laSeq = 0;
+// Latest writer of every register, by sequence number. Memory operands match exact
+// addresses like checkDependency does, by scanning this batch and the previous one.
+static UINT64 laWriterSeq[WRITER_KEYS];
+// Previous batch in program order; the carry entries are among them
+static const insInfo* laPrevBatch[LOOKAHEAD_MAX];
+static UINT32 laPrevCount = 0;
+
+// Per batch node: preds are batch indices, or LOOKAHEAD_MAX + c for carry entry c
+static UINT16 laPredCount[LOOKAHEAD_MAX];
+static UINT16 laPred[LOOKAHEAD_MAX][LA_MAX_PREDS];
+static UINT32 laPos[LOOKAHEAD_MAX + LA_CARRY];
+static UINT32 laUsed[LOOKAHEAD_MAX + LA_CARRY];
+static bool laPlaced[LOOKAHEAD_MAX];
+static UINT32 laOrder[LOOKAHEAD_MAX];
+
+// Previous batch's last placed entries, oldest first
+static UINT64 laCarrySeq[LA_CARRY];
+static UINT32 laCarryUsed[LA_CARRY];
+
+static UINT64 lookaheadForwardCount = 0;
+static UINT64 lookaheadBatches = 0;
+// Greedy ROB forwards over the same completed batches
+static UINT64 greedyBatchForwardCount = 0;
+static UINT64 greedyAtBatchStart = 0;
+
+// k == 0 disables the scheduler; otherwise it is at least LA_CARRY so a batch refills the whole carry
+VOID lookaheadReset(UINT32 k) {
+    lookaheadSize = (k == 0) ? 0 : std::min(std::max(k, (UINT32)LA_CARRY), (UINT32)LOOKAHEAD_MAX);
+    laCount = 0;
+    laSeq = 0;
+    laPrevCount = 0;
+    for (UINT32 i = 0; i < WRITER_KEYS; i++) {
+        laWriterSeq[i] = 0;
+    }
+    for (UINT32 c = 0; c < LA_CARRY; c++) {
+        laCarrySeq[c] = 0;
+        laCarryUsed[c] = BYPASS_CAPACITY;
+    }
+    lookaheadForwardCount = 0;
+    lookaheadBatches = 0;
+    greedyBatchForwardCount = 0;
+    greedyAtBatchStart = forwardCount;
+}
+
+// If-call: buffer the instruction, nonzero once the batch is full. Straight-line so Pin can inline it.
+ADDRINT PIN_FAST_ANALYSIS_CALL lookaheadRecord(const insInfo* info) {
+    laBatch[laCount] = info;
+    laCount++;
+    return laCount == lookaheadSize;
+}
+
+// Batch node or carry node producing seq, LA_NONE when it is out of reach
+UINT16 lookaheadNodeOf(UINT64 seq, UINT64 baseSeq) {
+    if (seq >= baseSeq) {
+        return (UINT16)(seq - baseSeq);
+    }
+    for (UINT32 c = 0; c < LA_CARRY; c++) {
+        if (laCarrySeq[c] == seq && seq != 0) {
+            return (UINT16)(LOOKAHEAD_MAX + c);
+        }
+    }
+    return LA_NONE;
+}
+
+// Sequence number of the latest writer of memAddr before batch node i, 0 when it is
+// older than the previous batch and so out of reach anyway
+UINT64 lookaheadMemWriter(UINT32 memAddr, UINT32 i, UINT64 baseSeq) {
+    for (UINT32 k = i; k > 0; k--) {
+        if (laBatch[k - 1]->hasDest == 2 && laBatch[k - 1]->memDest == memAddr) {
+            return baseSeq + k - 1;
+        }
+    }
+    for (UINT32 k = laPrevCount; k > 0; k--) {
+        if (laPrevBatch[k - 1]->hasDest == 2 && laPrevBatch[k - 1]->memDest == memAddr) {
+            return baseSeq - laPrevCount + k - 1;
+        }
+    }
+    return 0;
+}
+
+VOID lookaheadBuildDag(UINT64 baseSeq) {
+    for (UINT32 i = 0; i < laCount; i++) {
+        const insInfo* info = laBatch[i];
+        laPredCount[i] = 0;
+        for (UINT32 j = 0; j < info->operandVals.size(); j++) {
+            if (info->operandVals[j].isValid == 0) {
+                continue;
+            }
+            UINT64 writer = (info->operandVals[j].isValid == 2)
+                ? lookaheadMemWriter(info->operandVals[j].memAddr, i, baseSeq)
+                : laWriterSeq[writerKey(info->operandVals[j])];
+            UINT16 p = lookaheadNodeOf(writer, baseSeq);
+            if (p == LA_NONE) {
+                continue;
+            }
+            bool dup = false;
+            for (UINT32 k = 0; k < laPredCount[i]; k++) {
+                dup = dup || laPred[i][k] == p;
+            }
+            if (!dup && laPredCount[i] < LA_MAX_PREDS) {
+                laPred[i][laPredCount[i]++] = p;
+            }
+        }
+        if (info->hasDest == 1) {
+            laWriterSeq[info->destKey] = baseSeq + i;
+        }
+    }
+}
+
+// Then-call: schedule the full batch and compare with what the greedy ROB got
+VOID PIN_FAST_ANALYSIS_CALL lookaheadSchedule() {
+    UINT64 baseSeq = laSeq + 1;
+    laSeq += laCount;
+    lookaheadBuildDag(baseSeq);
+
+    // Carry entries sit just before position 0
+    for (UINT32 c = 0; c < LA_CARRY; c++) {
+        laPos[LOOKAHEAD_MAX + c] = c;
+        laUsed[LOOKAHEAD_MAX + c] = laCarryUsed[c];
+    }
+    for (UINT32 i = 0; i < laCount; i++) {
+        laPlaced[i] = false;
+        laUsed[i] = 0;
+    }
+
+    for (UINT32 step = 0; step < laCount; step++) {
+        // Positions are offset by LA_CARRY so carry entries are 0..LA_CARRY-1
+        UINT32 pos = step + LA_CARRY;
+        int best = -1;
+        int bestGain = -1;
+        for (UINT32 i = 0; i < laCount; i++) {
+            if (laPlaced[i]) {
+                continue;
+            }
+            bool ready = true;
+            int gain = 0;
+            for (UINT32 k = 0; k < laPredCount[i] && ready; k++) {
+                UINT16 p = laPred[i][k];
+                if (p < LOOKAHEAD_MAX && !laPlaced[p]) {
+                    ready = false;
+                } else if (pos - laPos[p] <= FORWARD_DISTANCE && laUsed[p] < BYPASS_CAPACITY) {
+                    gain++;
+                }
+            }
+            // Ties keep program order
+            if (ready && gain > bestGain) {
+                best = i;
+                bestGain = gain;
+            }
+        }
+
+        laPlaced[best] = true;
+        laPos[best] = pos;
+        laOrder[step] = best;
+        for (UINT32 k = 0; k < laPredCount[best]; k++) {
+            UINT16 p = laPred[best][k];
+            if (pos - laPos[p] <= FORWARD_DISTANCE && laUsed[p] < BYPASS_CAPACITY) {
+                laUsed[p]++;
+                lookaheadForwardCount++;
+            }
+        }
+    }
+
+    for (UINT32 c = 0; c < LA_CARRY; c++) {
+        UINT32 node = laOrder[laCount - LA_CARRY + c];
+        laCarrySeq[c] = baseSeq + node;
+        laCarryUsed[c] = laUsed[node];
+    }
+    for (UINT32 i = 0; i < laCount; i++) {
+        laPrevBatch[i] = laBatch[i];
+    }
+    laPrevCount = laCount;
+
+    lookaheadBatches++;
+    greedyBatchForwardCount += forwardCount - greedyAtBatchStart;
+    greedyAtBatchStart = forwardCount;
+    laCount = 0;
+}
+
+#endif
@@ -0,0 +1,145 @@
+// Load/store queue model next to the ROB. Loads and stores enter bounded queues
+// with their dynamic effective addresses and leave once they fall out of the
+// BUFFER_SIZE instruction window. A load forwards from the youngest older store
+// still in the store queue that covers it; a full queue stalls the incoming access
+// and pushes its oldest entry out early, which is what limits forwarding.
+// Include after RobEngine.h.
+#ifndef LSQ_H
+#define LSQ_H
+
+// Array bound for the configurable queue capacities
+#define LSQ_MAX_ENTRIES 256
+// Stores are indexed by the cache line they start in for the forwarding lookup.
+// A load also searches the line before its own for stores crossing into it,
+// which covers stores up to a line long.
+#define STLF_LINE_SHIFT 6
+#define STLF_BUCKETS 256
+#define LSQ_NO_FORWARD 0xFFFFFFFF
+
+struct lsqEntry {
+    ADDRINT addr = 0;
+    UINT32 size = 0;
+    UINT64 seq = 0;
+    // Cache level the store found its line in before filling it, with a cache model
+    UINT32 level = 0;
+    // Store number + 1 of the next older store in the same bucket, 0 for none
+    UINT64 prevSameBucket = 0;
+};
+
+static bool lsqEnabled = false;
+static UINT32 lqCapacity = 72;
+static UINT32 sqCapacity = 56;
+
+// Queues are rings over monotonic entry numbers; live entries are [head, tail)
+static lsqEntry storeQueue[LSQ_MAX_ENTRIES];
+static UINT64 sqHead = 0;
+static UINT64 sqTail = 0;
+static UINT64 loadQueueSeq[LSQ_MAX_ENTRIES];
+static UINT64 lqHead = 0;
+static UINT64 lqTail = 0;
+// Store number + 1 of the youngest store per bucket, 0 for none
+static UINT64 stlfBucket[STLF_BUCKETS];
+
+static UINT64 loadCount = 0;
+static UINT64 storeCount = 0;
+static UINT64 stlfCount = 0;
+// Load overlaps the youngest matching store without being covered by it
+static UINT64 stlfPartialCount = 0;
+static UINT64 lqFullStalls = 0;
+static UINT64 sqFullStalls = 0;
+
+VOID lsqReset(bool enabled, UINT32 loadCapacity, UINT32 storeCapacity) {
+    lsqEnabled = enabled;
+    lqCapacity = std::min(std::max(loadCapacity, 1U), (UINT32)LSQ_MAX_ENTRIES);
+    sqCapacity = std::min(std::max(storeCapacity, 1U), (UINT32)LSQ_MAX_ENTRIES);
+    sqHead = sqTail = 0;
+    lqHead = lqTail = 0;
+    for (UINT32 i = 0; i < STLF_BUCKETS; i++) {
+        stlfBucket[i] = 0;
+    }
+    loadCount = storeCount = 0;
+    stlfCount = stlfPartialCount = 0;
+    lqFullStalls = sqFullStalls = 0;
+}
+
+UINT32 stlfBucketOf(ADDRINT addr) {
+    return (UINT32)(addr >> STLF_LINE_SHIFT) % STLF_BUCKETS;
+}
+
+// Drop entries that have left the instruction window
+VOID lsqRetire() {
+    while (sqHead < sqTail && storeQueue[sqHead % sqCapacity].seq + BUFFER_SIZE <= iCount) {
+        sqHead++;
+    }
+    while (lqHead < lqTail && loadQueueSeq[lqHead % lqCapacity] + BUFFER_SIZE <= iCount) {
+        lqHead++;
+    }
+}
+
+// Called for each memory read of the current instruction (seq iCount).
+// Returns the forwarding store's level, or LSQ_NO_FORWARD.
+UINT32 lsqLoad(ADDRINT addr, UINT32 size) {
+    lsqRetire();
+    loadCount++;
+    if (lqTail - lqHead == lqCapacity) {
+        lqFullStalls++;
+        lqHead++;
+    }
+    loadQueueSeq[lqTail++ % lqCapacity] = iCount;
+
+    // Walk the chains of the line before the load through its last line together,
+    // youngest store first
+    UINT64 chain[3];
+    UINT32 chains = 0;
+    ADDRINT firstLine = addr >> STLF_LINE_SHIFT;
+    ADDRINT lastLine = (addr + size - 1) >> STLF_LINE_SHIFT;
+    for (ADDRINT line = (firstLine > 0) ? firstLine - 1 : 0; line <= lastLine && chains < 3; line++) {
+        chain[chains++] = stlfBucket[stlfBucketOf(line << STLF_LINE_SHIFT)];
+    }
+    while (true) {
+        UINT32 c = 0;
+        for (UINT32 i = 1; i < chains; i++) {
+            if (chain[i] > chain[c]) {
+                c = i;
+            }
+        }
+        UINT64 n = chain[c];
+        if (n == 0 || n - 1 < sqHead) {
+            break;
+        }
+        const lsqEntry& st = storeQueue[(n - 1) % sqCapacity];
+        chain[c] = st.prevSameBucket;
+        // Only older instructions forward
+        if (st.seq == iCount || st.addr >= addr + size || addr >= st.addr + st.size) {
+            continue;
+        }
+        if (st.addr <= addr && addr + size <= st.addr + st.size) {
+            stlfCount++;
+            return st.level;
+        }
+        stlfPartialCount++;
+        return LSQ_NO_FORWARD;
+    }
+    return LSQ_NO_FORWARD;
+}
+
+// Called for each memory write of the current instruction, after its reads
+VOID lsqStore(ADDRINT addr, UINT32 size, UINT32 level) {
+    lsqRetire();
+    storeCount++;
+    if (sqTail - sqHead == sqCapacity) {
+        sqFullStalls++;
+        sqHead++;
+    }
+    UINT64 n = sqTail++;
+    lsqEntry& st = storeQueue[n % sqCapacity];
+    UINT32 bucket = stlfBucketOf(addr);
+    st.addr = addr;
+    st.size = size;
+    st.seq = iCount;
+    st.level = level;
+    st.prevSameBucket = stlfBucket[bucket];
+    stlfBucket[bucket] = n + 1;
+}
+
+#endif
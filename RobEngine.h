@@ -0,0 +1,702 @@
+// Reorder buffer forwarding model shared by the Pin tools and the standalone
+// checkers. Include after defining BUFFER_SIZE and BASELINE.
+#ifndef ROB_ENGINE_H
+#define ROB_ENGINE_H
+
+// Opt-in fixes to the original checkDependency policy, see robIsLinkTo,
+// robNoForwardsWalk, the second forward and the final pull-in. They change the
+// forwarding numbers, so the default 0 reproduces the original exactly.
+#ifndef ROB_POLICY_FIXES
+#define ROB_POLICY_FIXES 0
+#endif
+
+#include <vector>
+#include <algorithm>
+#ifdef ROB_STANDALONE
+// Stand-ins for the few Pin types the model uses, for drivers built without Pin
+#include <cstdint>
+typedef int8_t INT8;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef uintptr_t ADDRINT;
+typedef void VOID;
+typedef bool BOOL;
+enum REG { REG_NONE = 0, REG_LAST = 1024 };
+inline REG REG_INVALID() { return REG_NONE; }
+#define PIN_FAST_ANALYSIS_CALL
+#else
+#include "pin.H"
+#endif
+using std::vector;
+
+#define ROB_NIL 0xFFFFFFFF
+// Spacing between order keys of consecutive entries; moves take the midpoint of their neighbours
+#define ORDER_GAP (1ULL << 16)
+
+// Writer table: live ROB entries per destination register, plus hashed buckets for memory
+#define MEM_KEYS 1024
+#define MEM_KEY_BASE ((UINT32)REG_LAST)
+#define ALWAYS_KEY (MEM_KEY_BASE + MEM_KEYS)
+#define NONE_KEY (ALWAYS_KEY + 1)
+#define WRITER_KEYS (NONE_KEY + 1)
+#define MAX_SRC_KEYS 4
+
+// path: record only (cannot forward), If/Then predicate, or full check every time
+#define PATH_RECORD 0
+#define PATH_PREDICATE 1
+#define PATH_ALWAYS 2
+
+struct insInfo;
+
+// Forward links name the other entry by slot plus sequence number, so a link to an
+// evicted entry never matches whatever reuses the slot, and by static instruction,
+// which is what the original compared (it stored INS handles)
+struct robLink {
+    UINT32 slot = ROB_NIL;
+    UINT64 seq = 0;
+    const insInfo* info = NULL;
+};
+
+struct operandVal {
+    // isValid: 0 = invalid, 1 = reg, 2 = mem
+    int isValid = 0;
+    REG regName = REG_INVALID();
+    UINT32 memAddr = 0;
+};
+
+// Operands of a static instruction, decoded once at instrumentation time
+struct insInfo {
+    ADDRINT pc = 0;
+    vector<operandVal> operandVals;
+    REG regDest = REG_INVALID();
+    UINT32 memDest = 0;
+    // hasDest: 0 = invalid, 1 = reg, 2 = mem
+    int hasDest = 0;
+    // Writer table keys checked by the inlined predicate, padded with ALWAYS_KEY
+    UINT32 srcKeys[MAX_SRC_KEYS];
+    UINT32 destKey = NONE_KEY;
+    // How the instruction is instrumented, see finishInsInfo
+    int path = PATH_RECORD;
+};
+
+struct robEl {
+    const insInfo* info = NULL;
+    UINT64 seq = 0;
+    REG regDest = REG_INVALID();
+    UINT32 memDest = 0;
+    // hasDest: 0 = invalid, 1 = reg, 2 = mem
+    int hasDest = 0;
+    vector<robLink> forwardsTo;
+    vector<robLink> forwardsFrom;
+    vector<robLink> missedForwardsTo;
+    // Logical (issue) order: doubly linked list over slots plus a monotonic order key
+    UINT32 prev = ROB_NIL;
+    UINT32 next = ROB_NIL;
+    UINT64 orderKey = 0;
+};
+
+// The running count of instructions is kept here
+// make it static to help the compiler optimize docount
+static UINT64 forwardCount = 0;
+// forwardCount split by the producer's destination kind
+static UINT64 regForwardCount = 0;
+static UINT64 memForwardCount = 0;
+static UINT64 missCount = 0;
+static UINT64 iCount = 0;
+
+// Cache level each recent load was served from, at seq % BUFFER_SIZE. The cache model
+// fills it in after the load's own ROB call; a stale seq means no level. Forwards
+// whose producer is such a load are counted by that level.
+#define ROB_LOAD_LEVELS 3
+struct robLoadLevel {
+    UINT64 seq = 0;
+    UINT32 level = 0;
+};
+static robLoadLevel loadLevels[BUFFER_SIZE];
+static UINT64 loadForwardsByLevel[ROB_LOAD_LEVELS];
+
+// Entries live in fixed slots for their whole lifetime; reordering only relinks them
+robEl rob[BUFFER_SIZE];
+UINT32 robHead = ROB_NIL;
+UINT32 robTail = ROB_NIL;
+UINT32 robCount = 0;
+
+// Count of live (ROB or pending) entries writing each key. A zero count for any
+// operand means checkDependency would find no producer, so the call can be skipped.
+static UINT32 liveWriters[WRITER_KEYS];
+
+// Instructions recorded by the inlined predicate but not yet placed in the ROB.
+// Slot iCount % BUFFER_SIZE holds the most recent one; drained slots point at noIns.
+static insInfo noIns;
+static const insInfo* pendingIns[BUFFER_SIZE];
+static UINT64 drainedSeq = 0;
+
+// Renumber the whole order list when two neighbours run out of key space
+VOID robRelabel() {
+    UINT64 key = ORDER_GAP;
+    for (UINT32 s = robHead; s != ROB_NIL; s = rob[s].next) {
+        rob[s].orderKey = key;
+        key += ORDER_GAP;
+    }
+}
+
+VOID robUnlink(UINT32 s) {
+    if (rob[s].prev != ROB_NIL) {
+        rob[rob[s].prev].next = rob[s].next;
+    } else {
+        robHead = rob[s].next;
+    }
+    if (rob[s].next != ROB_NIL) {
+        rob[rob[s].next].prev = rob[s].prev;
+    } else {
+        robTail = rob[s].prev;
+    }
+    rob[s].prev = ROB_NIL;
+    rob[s].next = ROB_NIL;
+}
+
+// Link unlinked slot s directly after pos (pos == ROB_NIL links it at the head)
+VOID robLinkAfter(UINT32 s, UINT32 pos) {
+    UINT32 nxt = (pos == ROB_NIL) ? robHead : rob[pos].next;
+    rob[s].prev = pos;
+    rob[s].next = nxt;
+    if (pos != ROB_NIL) {
+        rob[pos].next = s;
+    } else {
+        robHead = s;
+    }
+    if (nxt != ROB_NIL) {
+        rob[nxt].prev = s;
+    } else {
+        robTail = s;
+    }
+
+    UINT64 lo = (pos == ROB_NIL) ? 0 : rob[pos].orderKey;
+    if (nxt == ROB_NIL) {
+        if (lo > ~0ULL - ORDER_GAP) {
+            robRelabel();
+        } else {
+            rob[s].orderKey = lo + ORDER_GAP;
+        }
+    } else if (rob[nxt].orderKey - lo < 2) {
+        robRelabel();
+    } else {
+        rob[s].orderKey = lo + (rob[nxt].orderKey - lo) / 2;
+    }
+}
+
+// Move s to just after pos / just before pos in O(1) (amortized over relabels)
+VOID robMoveAfter(UINT32 s, UINT32 pos) {
+    if (s == pos || rob[pos].next == s) {
+        return;
+    }
+    robUnlink(s);
+    robLinkAfter(s, pos);
+}
+
+VOID robMoveBefore(UINT32 s, UINT32 pos) {
+    if (s == pos || rob[pos].prev == s) {
+        return;
+    }
+    robUnlink(s);
+    robLinkAfter(s, rob[pos].prev);
+}
+
+// Take a slot for a new tail entry, evicting the oldest entry when the buffer is full
+UINT32 robAllocate(const insInfo* info, UINT64 seq) {
+    UINT32 s;
+    if (robCount == BUFFER_SIZE) {
+        s = robHead;
+        robUnlink(s);
+        liveWriters[rob[s].info->destKey]--;
+    } else {
+        s = robCount++;
+    }
+    rob[s].info = info;
+    rob[s].seq = seq;
+    rob[s].regDest = info->regDest;
+    rob[s].memDest = info->memDest;
+    rob[s].hasDest = info->hasDest;
+    rob[s].forwardsTo.clear();
+    rob[s].forwardsFrom.clear();
+    rob[s].missedForwardsTo.clear();
+    return s;
+}
+
+// Walk n entries forward in order; ROB_NIL if that runs off the tail
+UINT32 robAdvance(UINT32 s, UINT32 n) {
+    while (n-- > 0 && s != ROB_NIL) {
+        s = rob[s].next;
+    }
+    return s;
+}
+
+// Walk n entries back in order; ROB_NIL if that runs off the head
+UINT32 robRetreat(UINT32 s, UINT32 n) {
+    while (n-- > 0 && s != ROB_NIL) {
+        s = rob[s].prev;
+    }
+    return s;
+}
+
+// Number of entries between s and the tail (0 for the tail), capped at limit
+UINT32 robTailDistance(UINT32 s, UINT32 limit) {
+    UINT32 d = 0;
+    for (UINT32 t = robTail; t != ROB_NIL && d < limit; t = rob[t].prev, d++) {
+        if (t == s) {
+            return d;
+        }
+    }
+    return limit;
+}
+
+// True when later follows earlier by 1..n positions
+bool robFollowsWithin(UINT32 later, UINT32 earlier, UINT32 n) {
+    UINT32 s = rob[earlier].next;
+    for (UINT32 i = 0; i < n && s != ROB_NIL; i++, s = rob[s].next) {
+        if (s == later) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether l points at entry s. The original compared INS handles, so a link
+// matched any instance of the same static instruction; the fix matches the entry.
+bool robIsLinkTo(const robLink& l, UINT32 s) {
+    if (ROB_POLICY_FIXES) {
+        return s != ROB_NIL && l.slot == s && l.seq == rob[s].seq;
+    }
+    return s != ROB_NIL && l.info == rob[s].info;
+}
+
+robLink robLinkTo(UINT32 s) {
+    robLink l;
+    l.slot = s;
+    l.seq = rob[s].seq;
+    l.info = rob[s].info;
+    return l;
+}
+
+VOID robAddForward(UINT32 from, UINT32 to) {
+    robLink toLink = robLinkTo(to);
+    robLink fromLink = robLinkTo(from);
+    rob[from].forwardsTo.push_back(toLink);
+    rob[to].forwardsFrom.push_back(fromLink);
+    forwardCount++;
+    if (rob[from].hasDest == 2) {
+        memForwardCount++;
+    } else {
+        regForwardCount++;
+    }
+    const robLoadLevel& load = loadLevels[rob[from].seq % BUFFER_SIZE];
+    if (load.seq == rob[from].seq) {
+        loadForwardsByLevel[load.level]++;
+    }
+}
+
+VOID robAddMissed(UINT32 from, UINT32 to) {
+    rob[from].missedForwardsTo.push_back(robLinkTo(to));
+    missCount++;
+}
+
+// Whether the "receives no forwards" walks after a target go on to s, the j-th entry
+// after it. They are meant to look at the two entries after the target, short of the
+// last two; the original bound, j < p + 3 || j < size - 2, ran on to the third-last.
+bool robNoForwardsWalk(UINT32 s, unsigned int j) {
+    if (ROB_POLICY_FIXES) {
+        return s != ROB_NIL && j < 2 && robTailDistance(s, 2) == 2;
+    }
+    return s != ROB_NIL && (j < 2 || robTailDistance(s, 2) == 2);
+}
+
+// A producer can keep forwarding only while it forwards to exactly one entry and receives none
+bool robCanStillForward(UINT32 s) {
+    return rob[s].forwardsTo.size() == 1 && rob[s].forwardsFrom.size() == 0;
+}
+
+// Place the entry for instruction seq in the ROB and schedule its forwards.
+// Returns the slot the entry landed in.
+UINT32 checkDependency(const insInfo* info, UINT64 seq) {
+    const vector<operandVal>& operandVals = info->operandVals;
+
+    // Ensure buffer does not exceed BUFFER_SIZE
+    UINT32 cur = robAllocate(info, seq);
+
+    if (operandVals.size() == 0) {
+        robLinkAfter(cur, robTail);
+        return cur;
+    }
+
+    // Latest and second latest producer of each operand, as slots
+    vector<UINT32> potentialForwardLocs(operandVals.size(), ROB_NIL);
+    vector<UINT32> prevPotentialForwardLocs(operandVals.size(), ROB_NIL);
+
+    for (UINT32 s = robHead; s != ROB_NIL; s = rob[s].next) {
+        // Go through each operand value of cur ins and see if match any previous dest
+        for (unsigned int j = 0; j < operandVals.size(); j++) {
+            if ((rob[s].hasDest == 1 && operandVals[j].isValid == 1 && rob[s].regDest == operandVals[j].regName)
+                    || (rob[s].hasDest == 2 && operandVals[j].isValid == 2 && rob[s].memDest == operandVals[j].memAddr)) {
+                // For each operand, get latest used entry
+                prevPotentialForwardLocs[j] = potentialForwardLocs[j];
+                potentialForwardLocs[j] = s;
+            }
+        }
+    }
+
+    // Ignore all potential locs if any other operand's potential locs have RAW after the checking potential loc
+    for (unsigned int i = 0; i < potentialForwardLocs.size(); i++) {
+        for (unsigned int j = 0; j < prevPotentialForwardLocs.size(); j++) {
+            if (i == j || potentialForwardLocs[i] == ROB_NIL || prevPotentialForwardLocs[j] == ROB_NIL) {
+                continue;
+            }
+            if (rob[potentialForwardLocs[i]].orderKey < rob[prevPotentialForwardLocs[j]].orderKey) {
+                potentialForwardLocs[i] = ROB_NIL;
+            }
+        }
+    }
+
+    robLinkAfter(cur, robTail);
+    bool canStillForward = false;
+    bool forwarding = false;
+
+    // Latest producer first. An operand without a producer sorts ahead of everything
+    // and stops forwarding for this instruction.
+    std::sort(potentialForwardLocs.begin(), potentialForwardLocs.end(), [](UINT32 a, UINT32 b) {
+        UINT64 keyA = (a == ROB_NIL) ? ~0ULL : rob[a].orderKey;
+        UINT64 keyB = (b == ROB_NIL) ? ~0ULL : rob[b].orderKey;
+        return keyA > keyB;
+    });
+    if (potentialForwardLocs[0] == ROB_NIL) {
+        return cur;
+    }
+    UINT32 p0 = potentialForwardLocs[0];
+
+    // 1. Furthest from EX first
+    if (robTailDistance(p0, 4) < 4) {
+        // EDGE CASE: best forward loc already being forwarded by default
+        robAddForward(p0, cur);
+        forwarding = true;
+        canStillForward = robCanStillForward(p0);
+    } else if (!BASELINE && rob[p0].forwardsTo.size() < 3) {
+        // Check if potForward INS has space to accomodate: first of the next 3 entries that
+        // receives no forward, unless an entry before it forwards to someone else
+        UINT32 best = ROB_NIL;
+        UINT32 s = rob[p0].next;
+        for (unsigned int j = 0; j < 3 && s != cur; j++, s = rob[s].next) {
+            if (rob[s].forwardsFrom.size() == 0) {
+                best = s;
+                break;
+            }
+            if (rob[s].forwardsTo.size() > 0) {
+                if (rob[s].forwardsTo.size() == 1 && j == 0 && robIsLinkTo(rob[s].forwardsTo[0], rob[s].next)) {
+                    continue;
+                }
+                // this spot's instruction is forwarding to another inst, don't dislodge its forwarding.
+                break;
+            }
+        }
+
+        UINT32 p0Next = rob[p0].next;
+        if (rob[p0].forwardsTo.size() == 0 && robTailDistance(p0Next, 4) == 4 && rob[p0Next].forwardsFrom.size() == 0) {
+            UINT32 p0Next2 = rob[p0Next].next;
+            if (rob[p0Next2].forwardsFrom.size() == 0
+                    || (rob[p0Next2].forwardsFrom.size() == 1 && !robIsLinkTo(rob[p0Next2].forwardsFrom[0], p0Next))) {
+                best = p0Next;
+            }
+        }
+
+        if (best == ROB_NIL) {
+            robAddMissed(p0, cur);
+        } else {
+            // have space before best
+            robAddForward(p0, cur);
+            robMoveBefore(cur, best);
+            forwarding = true;
+            canStillForward = robCanStillForward(p0);
+        }
+    } else {
+        robAddMissed(p0, cur);
+    }
+
+    // 2. Check if second forwarding exist/possible
+    if (potentialForwardLocs.size() <= 1) {
+        return cur;
+    }
+    UINT32 p1 = potentialForwardLocs[1];
+    // Check if can still forward to next target with both cur inst and latest target back to back
+    // Means next target must have space to accomdate two inst
+    if (robFollowsWithin(cur, p1, 3)) {
+        robAddForward(p1, cur);
+        if (!robCanStillForward(p1)) {
+            canStillForward = false;
+        }
+    } else if (forwarding && canStillForward && p1 != p0) {
+        if (!BASELINE && rob[p1].forwardsTo.size() < 2) {
+            // The entries after the latest target must receive no forwards
+            bool noForwards = true;
+            UINT32 s = rob[p0].next;
+            for (unsigned int j = 0; robNoForwardsWalk(s, j); j++, s = rob[s].next) {
+                if (rob[s].forwardsFrom.size() != 0) {
+                    noForwards = false;
+                }
+            }
+            UINT32 p1Next = rob[p1].next;
+            UINT32 p1Next2 = robAdvance(p1, 2);
+            bool roomAfterP1 = p1Next2 != ROB_NIL && robTailDistance(p1Next2, 2) == 2;
+            if (roomAfterP1 && rob[p1Next2].forwardsFrom.size() == 1 && robIsLinkTo(rob[p1Next2].forwardsFrom[0], p1Next)) {
+                noForwards = true;
+            }
+            if (noForwards) {
+                // p1, p0, cur back to back
+                robAddForward(p1, cur);
+                robMoveAfter(p0, p1);
+                robMoveAfter(cur, p0);
+                canStillForward = robCanStillForward(p1);
+            } else if (ROB_POLICY_FIXES && roomAfterP1 && rob[p1].prev != ROB_NIL && rob[p1Next2].forwardsFrom.size() == 0
+                    && rob[p1Next].forwardsFrom.size() == 1 && robIsLinkTo(rob[p1Next].forwardsFrom[0], rob[p1].prev)) {
+                // p0 ahead of p1's predecessor, cur right after p1. The original tested
+                // forwardsFrom[1] of the one-entry list, so this never fired.
+                UINT32 p1Prev = rob[p1].prev;
+                robAddForward(p1, cur);
+                robMoveBefore(p0, p1Prev);
+                robMoveAfter(cur, p1);
+                canStillForward = robCanStillForward(p1);
+            } else {
+                canStillForward = false;
+            }
+        } else {
+            robAddMissed(p1, cur);
+            canStillForward = false;
+        }
+    } else {
+        robAddMissed(p1, cur);
+        canStillForward = false;
+    }
+
+    // 3. Check if third forwarding exist/possible
+    if (potentialForwardLocs.size() <= 2) {
+        return cur;
+    }
+    UINT32 p2 = potentialForwardLocs[2];
+
+    if (robFollowsWithin(cur, p2, 3)) {
+        robAddForward(p2, cur);
+    } else if (!BASELINE && forwarding && canStillForward && p2 != p1) {
+        if (rob[p2].forwardsTo.size() == 0) {
+            UINT32 s = rob[p2].next;
+            for (unsigned int j = 0; robNoForwardsWalk(s, j); j++, s = rob[s].next) {
+                if (rob[s].forwardsFrom.size() > 0) {
+                    canStillForward = false;
+                    break;
+                }
+            }
+
+            if (canStillForward) {
+                // next entries after third forwarding have no forwardFrom. So move cur and its previous producers up
+                robAddForward(p2, cur);
+                robMoveAfter(p1, p2);
+                robMoveAfter(p0, p1);
+                robMoveAfter(cur, p0);
+            } else if (rob[cur].next == p0 && rob[p0].next == p1) {
+                // move last target down if possible
+                if (rob[p2].missedForwardsTo.size() == 0 && rob[p1].prev != ROB_NIL && rob[rob[p1].prev].forwardsTo.size() == 0) {
+                    robAddForward(p2, cur);
+                    robMoveAfter(p2, p1);
+                }
+            } else {
+                robAddMissed(p2, cur);
+            }
+        }
+    }
+
+    if (!BASELINE && !forwarding && cur == robTail) {
+        // Pull untouched producers in ahead of cur: the k-th goes just before the
+        // entry k places ahead of cur (a no-op when it already is that entry).
+        // The original found producers by their position before these moves, so a
+        // producer matching two operands yielded whichever entry had moved into its
+        // place by the second time; the fix always takes the producer itself.
+        vector<UINT32> placesAhead(potentialForwardLocs.size());
+        if (!ROB_POLICY_FIXES) {
+            for (unsigned int j = 0; j < potentialForwardLocs.size(); j++) {
+                placesAhead[j] = robTailDistance(potentialForwardLocs[j], BUFFER_SIZE);
+            }
+        }
+        UINT32 moveToEndCount = 0;
+        for (unsigned int j = 0; j < potentialForwardLocs.size(); j++) {
+            UINT32 p = ROB_POLICY_FIXES ? potentialForwardLocs[j] : robRetreat(cur, placesAhead[j]);
+            if (rob[p].forwardsTo.size() == 0 && rob[p].forwardsFrom.size() == 0 && rob[p].missedForwardsTo.size() == 0) {
+                moveToEndCount++;
+                robAddForward(p, cur);
+                robMoveBefore(p, robRetreat(cur, moveToEndCount));
+            }
+        }
+    }
+    return cur;
+}
+
+// Append pending instructions up to seq upTo to the ROB. They had no producer for
+// some operand, so they take no part in forwarding. Anything older than the ring
+// was already pushed out by the BUFFER_SIZE instructions after it.
+VOID robDrain(UINT64 upTo) {
+    UINT64 first = drainedSeq + 1;
+    if (iCount >= BUFFER_SIZE && first < iCount - BUFFER_SIZE + 1) {
+        first = iCount - BUFFER_SIZE + 1;
+    }
+    for (UINT64 seq = first; seq <= upTo; seq++) {
+        UINT32 idx = seq % BUFFER_SIZE;
+        UINT32 s = robAllocate(pendingIns[idx], seq);
+        robLinkAfter(s, robTail);
+        pendingIns[idx] = &noIns;
+    }
+    if (upTo > drainedSeq) {
+        drainedSeq = upTo;
+    }
+}
+
+// Empty the window as a branch mispredict does: every entry and pending instruction
+// is at or before the branch, so none of them forwards to what follows it
+VOID robFlush() {
+    for (UINT32 s = robHead; s != ROB_NIL; s = rob[s].next) {
+        liveWriters[rob[s].info->destKey]--;
+    }
+    for (UINT32 s = 0; s < BUFFER_SIZE; s++) {
+        rob[s].prev = ROB_NIL;
+        rob[s].next = ROB_NIL;
+    }
+    robHead = ROB_NIL;
+    robTail = ROB_NIL;
+    robCount = 0;
+    // Drained and placed slots already point at noIns; the rest are still pending
+    for (UINT32 i = 0; i < BUFFER_SIZE; i++) {
+        if (pendingIns[i] != &noIns) {
+            liveWriters[pendingIns[i]->destKey]--;
+            pendingIns[i] = &noIns;
+        }
+    }
+    drainedSeq = iCount;
+}
+
+// Count the instruction and record it as pending; its slot in the ring drops the
+// instruction BUFFER_SIZE back, which can no longer be in the ROB.
+// Straight-line so Pin can inline it.
+VOID PIN_FAST_ANALYSIS_CALL recordIns(const insInfo* info) {
+    iCount++;
+    UINT32 idx = iCount % BUFFER_SIZE;
+    liveWriters[pendingIns[idx]->destKey]--;
+    pendingIns[idx] = info;
+    liveWriters[info->destKey]++;
+}
+
+// If-call: same as recordIns, returning nonzero when every operand has a live
+// producer once the oldest entry has left, i.e. forwarding is possible
+ADDRINT PIN_FAST_ANALYSIS_CALL mayForward(const insInfo* info) {
+    iCount++;
+    UINT32 idx = iCount % BUFFER_SIZE;
+    liveWriters[pendingIns[idx]->destKey]--;
+    ADDRINT live = (liveWriters[info->srcKeys[0]] != 0) & (liveWriters[info->srcKeys[1]] != 0)
+                    & (liveWriters[info->srcKeys[2]] != 0) & (liveWriters[info->srcKeys[3]] != 0);
+    pendingIns[idx] = info;
+    liveWriters[info->destKey]++;
+    return live;
+}
+
+// Then-call: bring the ROB up to date and run the full scheduling logic
+VOID PIN_FAST_ANALYSIS_CALL forwardDependency(const insInfo* info) {
+    robDrain(iCount - 1);
+    pendingIns[iCount % BUFFER_SIZE] = &noIns;
+    drainedSeq = iCount;
+    checkDependency(info, iCount);
+}
+
+// Instructions with too many operands for the predicate take the full path every time
+VOID PIN_FAST_ANALYSIS_CALL checkAllDependency(const insInfo* info) {
+    recordIns(info);
+    forwardDependency(info);
+}
+
+UINT32 writerKey(const operandVal& val) {
+    if (val.isValid == 1) {
+        return (UINT32)val.regName;
+    }
+    return MEM_KEY_BASE + val.memAddr % MEM_KEYS;
+}
+
+// Fill in writer keys and the instrumentation path once operandVals and dest are decoded
+VOID finishInsInfo(insInfo* info) {
+    if (info->hasDest != 0) {
+        info->destKey = writerKey(info->operandVals[0]);
+    }
+    for (unsigned int i = 0; i < MAX_SRC_KEYS; i++) {
+        info->srcKeys[i] = ALWAYS_KEY;
+    }
+    for (unsigned int i = 0; i < info->operandVals.size() && i < MAX_SRC_KEYS; i++) {
+        info->srcKeys[i] = writerKey(info->operandVals[i]);
+    }
+
+    bool canForward = info->operandVals.size() > 0;
+    for (unsigned int i = 0; i < info->operandVals.size(); i++) {
+        // An operand that is neither register nor memory never has a producer
+        if (info->operandVals[i].isValid == 0) {
+            canForward = false;
+        }
+    }
+    if (!canForward) {
+        // Only occupies a ROB entry
+        info->path = PATH_RECORD;
+    } else if (info->operandVals.size() > MAX_SRC_KEYS) {
+        info->path = PATH_ALWAYS;
+    } else {
+        info->path = PATH_PREDICATE;
+    }
+}
+
+// What the inserted analysis calls do for one instruction; true when the slow path ran
+bool runIns(const insInfo* info) {
+    if (info->path == PATH_RECORD) {
+        recordIns(info);
+        return false;
+    }
+    if (info->path == PATH_ALWAYS) {
+        checkAllDependency(info);
+        return true;
+    }
+    if (mayForward(info)) {
+        forwardDependency(info);
+        return true;
+    }
+    return false;
+}
+
+VOID robReset() {
+    for (UINT32 s = 0; s < BUFFER_SIZE; s++) {
+        rob[s].prev = ROB_NIL;
+        rob[s].next = ROB_NIL;
+    }
+    robHead = ROB_NIL;
+    robTail = ROB_NIL;
+    robCount = 0;
+    for (UINT32 k = 0; k < WRITER_KEYS; k++) {
+        liveWriters[k] = 0;
+    }
+    liveWriters[ALWAYS_KEY] = 1;
+    for (UINT32 i = 0; i < BUFFER_SIZE; i++) {
+        pendingIns[i] = &noIns;
+    }
+    drainedSeq = 0;
+    forwardCount = 0;
+    regForwardCount = 0;
+    memForwardCount = 0;
+    missCount = 0;
+    iCount = 0;
+    for (UINT32 i = 0; i < BUFFER_SIZE; i++) {
+        loadLevels[i] = robLoadLevel();
+    }
+    for (UINT32 l = 0; l < ROB_LOAD_LEVELS; l++) {
+        loadForwardsByLevel[l] = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,151 @@
+// Fuzz driver for the forwarding model: feeds random instruction streams through
+// the engine and the reference in lockstep and stops at the first divergence.
+// Builds without Pin:
+//   g++ -O2 -o RobFuzz RobFuzz.cpp              (RobScan policy)
+//   g++ -O2 -DBASELINE=1 -o RobFuzz RobFuzz.cpp (RobScanBaseline policy)
+// The reference is the original algorithm only. With -DROB_POLICY_FIXES=1 the
+// engine is instead checked against the invariants the fixes promise after every
+// instruction, and "RobFuzz 20 20000" against the totals recorded for the fixes.
+// Usage: RobFuzz [seeds] [instructions per seed] [first seed]
+#include <iostream>
+#include <cstdlib>
+#include <random>
+#define ROB_STANDALONE
+#define BUFFER_SIZE 256
+#ifndef BASELINE
+#define BASELINE 0
+#endif
+#include "RobEngine.h"
+#include "RobReference.h"
+using std::cerr;
+using std::cout;
+using std::endl;
+
+// Small register and address pools so producers are common inside the window
+#define FUZZ_REGS 12
+#define FUZZ_ADDRS 24
+#define FUZZ_STATIC_INS 512
+
+insInfo* randomIns(std::mt19937& rng) {
+    insInfo* info = new insInfo;
+    unsigned int operands = rng() % 6;
+    for (unsigned int i = 0; i < operands; i++) {
+        operandVal newVal;
+        unsigned int kind = rng() % 16;
+        if (kind < 11) {
+            newVal.isValid = 1;
+            newVal.regName = (REG)(1 + rng() % FUZZ_REGS);
+        } else if (kind < 15) {
+            newVal.isValid = 2;
+            newVal.memAddr = 0x1000 + 8 * (rng() % FUZZ_ADDRS);
+        }
+        if (i == 0) {
+            info->hasDest = newVal.isValid;
+            info->regDest = newVal.regName;
+            info->memDest = newVal.memAddr;
+        }
+        info->operandVals.push_back(newVal);
+    }
+    finishInsInfo(info);
+    return info;
+}
+
+#if ROB_POLICY_FIXES
+// Totals of "RobFuzz 20 20000" with the fixes, indexed by BASELINE
+static const UINT64 fixesForwards[2] = { 114591, 19749 };
+static const UINT64 fixesMisses[2] = { 3634, 121279 };
+
+bool fuzzFail(const char* what, UINT32 s) {
+    cerr << what << " at instruction " << iCount << ", slot " << s << endl;
+    return false;
+}
+
+// What the fixes promise: the order list is intact, and every link names one
+// dynamic entry, older than its consumer, with the matching link at the other end
+// while both are live
+bool checkInvariants() {
+    UINT32 count = 0;
+    UINT32 prev = ROB_NIL;
+    for (UINT32 s = robHead; s != ROB_NIL; s = rob[s].next) {
+        if (rob[s].prev != prev || (prev != ROB_NIL && rob[prev].orderKey >= rob[s].orderKey)) {
+            return fuzzFail("order list broken", s);
+        }
+        prev = s;
+        count++;
+    }
+    if (prev != robTail || count != robCount) {
+        return fuzzFail("order list length or tail differs", prev);
+    }
+    for (UINT32 s = robHead; s != ROB_NIL; s = rob[s].next) {
+        for (UINT32 k = 0; k < rob[s].forwardsFrom.size(); k++) {
+            const robLink& l = rob[s].forwardsFrom[k];
+            if (l.seq >= rob[s].seq) {
+                return fuzzFail("forward from a younger entry", s);
+            }
+            // An evicted producer's slot is reused at once, so a live one keeps its seq
+            if (rob[l.slot].seq != l.seq) {
+                continue;
+            }
+            bool back = false;
+            for (UINT32 m = 0; m < rob[l.slot].forwardsTo.size(); m++) {
+                back = back || robIsLinkTo(rob[l.slot].forwardsTo[m], s);
+            }
+            if (!back) {
+                return fuzzFail("forward link without its reverse", s);
+            }
+        }
+    }
+    return true;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    unsigned int seeds = argc > 1 ? atoi(argv[1]) : 200;
+    unsigned int length = argc > 2 ? atoi(argv[2]) : 20000;
+    unsigned int firstSeed = argc > 3 ? atoi(argv[3]) : 1;
+
+    UINT64 totalForwards = 0;
+    UINT64 totalMisses = 0;
+    for (unsigned int seed = firstSeed; seed < firstSeed + seeds; seed++) {
+        std::mt19937 rng(seed);
+        // A fixed set of static instructions, replayed in random order like a program would
+        vector<insInfo*> program;
+        for (unsigned int i = 0; i < FUZZ_STATIC_INS; i++) {
+            program.push_back(randomIns(rng));
+        }
+
+        robReset();
+        refReset();
+        unsigned int pc = 0;
+        for (unsigned int i = 0; i < length; i++) {
+            // Mostly straight-line runs with occasional jumps
+            pc = (rng() % 8 == 0) ? rng() % FUZZ_STATIC_INS : (pc + 1) % FUZZ_STATIC_INS;
+#if ROB_POLICY_FIXES
+            // Like the lockstep, only after the slow path; pending entries are not placed yet
+            bool ok = !runIns(program[pc]) || checkInvariants();
+#else
+            bool ok = lockstepIns(program[pc], cerr);
+#endif
+            if (!ok) {
+                cerr << "seed " << seed << endl;
+                return 1;
+            }
+        }
+        totalForwards += forwardCount;
+        totalMisses += missCount;
+        for (unsigned int i = 0; i < program.size(); i++) {
+            delete program[i];
+        }
+    }
+#if ROB_POLICY_FIXES
+    if (seeds == 20 && length == 20000 && firstSeed == 1
+            && (totalForwards != fixesForwards[BASELINE] || totalMisses != fixesMisses[BASELINE])) {
+        cerr << totalForwards << " forwards, " << totalMisses << " misses; expected "
+             << fixesForwards[BASELINE] << ", " << fixesMisses[BASELINE] << endl;
+        return 1;
+    }
+#endif
+    cout << (ROB_POLICY_FIXES ? "Invariants held over " : "No divergence over ") << seeds << " seeds of " << length << " instructions ("
+         << "BASELINE " << BASELINE << ", ROB_POLICY_FIXES " << ROB_POLICY_FIXES << "), " << totalForwards << " forwards, " << totalMisses << " misses" << endl;
+    return 0;
+}
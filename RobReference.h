@@ -0,0 +1,421 @@
+// Reference forwarding model: the original vector checkDependency from RobScan.cpp,
+// as it was before the slot pool, ported to take an insInfo. Entries are kept in
+// issue order in a plain vector, every move is an erase/insert with the original
+// index bookkeeping, and links are compared by static instruction as the INS
+// handles were. Only reads past the end of a vector are guarded (see the notes
+// below); nothing else is changed, so the engine is checked against the algorithm
+// it replaced rather than against a copy of itself. It has no ROB_POLICY_FIXES
+// changes, so lockstep checking needs an engine built without them.
+// Include after RobEngine.h.
+#ifndef ROB_REFERENCE_H
+#define ROB_REFERENCE_H
+
+#include <ostream>
+#include <functional>
+
+// The other end of a forward: its sequence number (to compare against the engine)
+// and its static instruction (what the original stored)
+struct refLink {
+    UINT64 seq = 0;
+    const insInfo* info = NULL;
+};
+
+struct refEl {
+    const insInfo* info = NULL;
+    UINT64 seq = 0;
+    REG regDest = REG_INVALID();
+    UINT32 memDest = 0;
+    // hasDest: 0 = invalid, 1 = reg, 2 = mem
+    int hasDest = 0;
+    vector<refLink> forwardsTo;
+    vector<refLink> forwardsFrom;
+    vector<refLink> missedForwardsTo;
+};
+
+#define REF_NONE 0xFFFFFFFF
+
+static UINT64 refForwardCount = 0;
+static UINT64 refMissCount = 0;
+vector<refEl> refRob;
+
+// Set once the engines disagree; checking stops after the first divergence
+static bool lockstepDiverged = false;
+static UINT64 lockstepChecked = 0;
+
+unsigned int refIndexOf(UINT64 seq) {
+    for (unsigned int i = 0; i < refRob.size(); i++) {
+        if (refRob[i].seq == seq) {
+            return i;
+        }
+    }
+    return REF_NONE;
+}
+
+refEl& refAt(UINT64 seq) {
+    return refRob[refIndexOf(seq)];
+}
+
+refLink refLinkTo(const refEl& el) {
+    refLink l;
+    l.seq = el.seq;
+    l.info = el.info;
+    return l;
+}
+
+// link == rob[i].inst in the original
+bool refSame(const refLink& l, const refEl& el) {
+    return l.info == el.info;
+}
+
+// forwardsFrom[k] == other.inst; the original also read past the end of the list
+// here, which is taken as no match
+bool refFromIs(const refEl& el, unsigned int k, const refEl& other) {
+    return k < el.forwardsFrom.size() && refSame(el.forwardsFrom[k], other);
+}
+
+VOID refForward(unsigned int from, unsigned int to) {
+    refRob[to].forwardsFrom.push_back(refLinkTo(refRob[from]));
+    refRob[from].forwardsTo.push_back(refLinkTo(refRob[to]));
+    refForwardCount++;
+}
+
+VOID refMissed(unsigned int from, unsigned int to) {
+    refRob[from].missedForwardsTo.push_back(refLinkTo(refRob[to]));
+    refMissCount++;
+}
+
+bool refCanStillForward(unsigned int i) {
+    return refRob[i].forwardsTo.size() == 1 && refRob[i].forwardsFrom.size() == 0;
+}
+
+VOID refCheckDependency(const insInfo* info, UINT64 seq) {
+    const vector<operandVal>& operandVals = info->operandVals;
+    refEl curEl;
+    curEl.info = info;
+    curEl.seq = seq;
+    curEl.regDest = info->regDest;
+    curEl.memDest = info->memDest;
+    curEl.hasDest = info->hasDest;
+
+    // Ensure buffer does not exceed BUFFER_SIZE
+    if (refRob.size() == BUFFER_SIZE) {
+        refRob.erase(refRob.begin());
+    }
+    if (operandVals.size() == 0) {
+        refRob.push_back(curEl);
+        return;
+    }
+
+    vector<unsigned int> potentialForwardLocs(operandVals.size(), refRob.size() + 1);
+    vector<unsigned int> prevPotentialForwardLocs(operandVals.size(), refRob.size() + 1);
+
+    for (unsigned int i = 0; i < refRob.size(); i++) {
+        for (unsigned int j = 0; j < operandVals.size(); j++) {
+            // Guard: the original indexed operandVals with the ROB index i for memory operands
+            if ((refRob[i].hasDest == 1 && operandVals[j].isValid == 1 && refRob[i].regDest == operandVals[j].regName)
+                    || (refRob[i].hasDest == 2 && operandVals[j].isValid == 2 && refRob[i].memDest == operandVals[j].memAddr)) {
+                prevPotentialForwardLocs[j] = potentialForwardLocs[j];
+                potentialForwardLocs[j] = i;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < potentialForwardLocs.size(); i++) {
+        for (unsigned int j = 0; j < prevPotentialForwardLocs.size(); j++) {
+            if (i == j || potentialForwardLocs[i] == refRob.size() + 1 || prevPotentialForwardLocs[j] == refRob.size() + 1) {
+                continue;
+            }
+            if (potentialForwardLocs[i] < prevPotentialForwardLocs[j]) {
+                potentialForwardLocs[i] = refRob.size() + 1;
+            }
+        }
+    }
+
+    refRob.push_back(curEl);
+    unsigned int curElIdx = refRob.size() - 1;
+    bool canStillForward = false;
+    bool forwarding = false;
+
+    std::sort(potentialForwardLocs.begin(), potentialForwardLocs.end(), std::greater<unsigned int>());
+
+    // 1. Furthest from EX first
+    if (potentialForwardLocs[0] == refRob.size()) {
+        return;
+    } else if (potentialForwardLocs[0] + 5 > refRob.size()) {
+        // Guard: written as p0 > size - 5, which wrapped around (and later indexed
+        // past the end) while the ROB held fewer than 5 entries
+        refForward(potentialForwardLocs[0], curElIdx);
+        forwarding = true;
+        canStillForward = refCanStillForward(potentialForwardLocs[0]);
+    } else if (!BASELINE && refRob[potentialForwardLocs[0]].forwardsTo.size() < 3) {
+        unsigned int bestIdx = refRob.size();
+        for (unsigned int j = potentialForwardLocs[0] + 3; j > potentialForwardLocs[0]; j--) {
+            if (j > refRob.size() - 2) {
+                continue;
+            }
+            if (refRob[j].forwardsFrom.size() == 0) {
+                bestIdx = std::min(j, bestIdx);
+            } else if (refRob[j].forwardsTo.size() > 0) {
+                if (refRob[j].forwardsTo.size() == 1 && j == potentialForwardLocs[0] + 1 && refSame(refRob[j].forwardsTo[0], refRob[j + 1])) {
+                    continue;
+                }
+                bestIdx = refRob.size();
+            }
+        }
+
+        if (refRob[potentialForwardLocs[0]].forwardsTo.size() == 0) {
+            if (potentialForwardLocs[0] + 1 <= refRob.size() - 3 && refRob[potentialForwardLocs[0] + 1].forwardsFrom.size() == 0) {
+                if (potentialForwardLocs[0] + 2 <= refRob.size() - 4
+                        && (refRob[potentialForwardLocs[0] + 2].forwardsFrom.size() == 0
+                        || (refRob[potentialForwardLocs[0] + 2].forwardsFrom.size() == 1 && !refFromIs(refRob[potentialForwardLocs[0] + 2], 0, refRob[potentialForwardLocs[0] + 1])))) {
+                    bestIdx = potentialForwardLocs[0] + 1;
+                }
+            }
+        }
+
+        if (bestIdx == refRob.size()) {
+            refMissed(potentialForwardLocs[0], curElIdx);
+        } else {
+            refForward(potentialForwardLocs[0], curElIdx);
+            refEl tmpEl = refRob[curElIdx];
+            refRob.erase(refRob.begin() + curElIdx);
+            refRob.insert(refRob.begin() + bestIdx, tmpEl);
+            forwarding = true;
+            curElIdx = bestIdx;
+            canStillForward = refCanStillForward(potentialForwardLocs[0]);
+        }
+    } else {
+        refMissed(potentialForwardLocs[0], curElIdx);
+    }
+
+    // 2. Check if second forwarding exist/possible
+    if (potentialForwardLocs.size() <= 1 || potentialForwardLocs[1] == refRob.size()) {
+        return;
+    }
+    if (curElIdx > potentialForwardLocs[1] && curElIdx <= potentialForwardLocs[1] + 3) {
+        refForward(potentialForwardLocs[1], curElIdx);
+        if (!refCanStillForward(potentialForwardLocs[1])) {
+            canStillForward = false;
+        }
+    } else if (forwarding && canStillForward && potentialForwardLocs[1] != potentialForwardLocs[0]) {
+        if (!BASELINE && refRob[potentialForwardLocs[1]].forwardsTo.size() < 2) {
+            bool noForwards = true;
+            // Guard: j < size; the walk could run past the last entry
+            for (unsigned int j = potentialForwardLocs[0] + 1; j < refRob.size() && (j < potentialForwardLocs[0] + 3 || j < refRob.size() - 2); j++) {
+                if (refRob[j].forwardsFrom.size() != 0) {
+                    noForwards = false;
+                }
+            }
+            if (potentialForwardLocs[1] + 2 < refRob.size() - 2 && refRob[potentialForwardLocs[1] + 2].forwardsFrom.size() == 1
+                    && refFromIs(refRob[potentialForwardLocs[1] + 2], 0, refRob[potentialForwardLocs[1] + 1])) {
+                noForwards = true;
+            }
+            if (noForwards) {
+                refForward(potentialForwardLocs[1], curElIdx);
+                refEl tmpEl_1 = refRob[curElIdx];
+                refEl tmpEl_2 = refRob[potentialForwardLocs[0]];
+                refRob.erase(refRob.begin() + curElIdx);
+                refRob.erase(refRob.begin() + potentialForwardLocs[0]);
+                refRob.insert(refRob.begin() + potentialForwardLocs[1] + 1, tmpEl_2);
+                refRob.insert(refRob.begin() + potentialForwardLocs[1] + 2, tmpEl_1);
+                potentialForwardLocs[0] = potentialForwardLocs[1] + 1;
+                curElIdx = potentialForwardLocs[1] + 2;
+                canStillForward = refCanStillForward(potentialForwardLocs[1]);
+            } else if (potentialForwardLocs[1] + 2 < refRob.size() - 2 && potentialForwardLocs[1] > 0
+                    && refRob[potentialForwardLocs[1] + 2].forwardsFrom.size() == 0 && refRob[potentialForwardLocs[1] + 1].forwardsFrom.size() == 1
+                    && refFromIs(refRob[potentialForwardLocs[1] + 1], 1, refRob[potentialForwardLocs[1] - 1])) {
+                // Guards: p1 - 1 >= 0 was always true, and forwardsFrom[1] of a one-entry
+                // list is past the end, so this branch never fires
+                refForward(potentialForwardLocs[1], curElIdx);
+                refEl tmpEl_1 = refRob[curElIdx];
+                refEl tmpEl_2 = refRob[potentialForwardLocs[0]];
+                refRob.erase(refRob.begin() + curElIdx);
+                refRob.erase(refRob.begin() + potentialForwardLocs[0]);
+                refRob.insert(refRob.begin() + potentialForwardLocs[1] - 1, tmpEl_2);
+                refRob.insert(refRob.begin() + potentialForwardLocs[1] + 1, tmpEl_1);
+                potentialForwardLocs[0] = potentialForwardLocs[1] - 1;
+                curElIdx = potentialForwardLocs[1] + 1;
+                canStillForward = refCanStillForward(potentialForwardLocs[1]);
+            } else {
+                canStillForward = false;
+            }
+        } else {
+            refMissed(potentialForwardLocs[1], curElIdx);
+            canStillForward = false;
+        }
+    } else {
+        refMissed(potentialForwardLocs[1], curElIdx);
+        canStillForward = false;
+    }
+
+    // 3. Check if third forwarding exist/possible
+    if (potentialForwardLocs.size() <= 2 || potentialForwardLocs[2] == refRob.size()) {
+        return;
+    }
+    if (curElIdx > potentialForwardLocs[2] && curElIdx <= potentialForwardLocs[2] + 3) {
+        refForward(potentialForwardLocs[2], curElIdx);
+    } else if (!BASELINE && forwarding && canStillForward && potentialForwardLocs[2] != potentialForwardLocs[1]) {
+        if (refRob[potentialForwardLocs[2]].forwardsTo.size() == 0) {
+            // Guard: i < size, as above
+            for (unsigned int i = potentialForwardLocs[2] + 1; i < refRob.size() && (i < potentialForwardLocs[2] + 3 || i < refRob.size() - 2); i++) {
+                if (refRob[i].forwardsFrom.size() > 0) {
+                    canStillForward = false;
+                    break;
+                }
+            }
+
+            if (curElIdx > potentialForwardLocs[2] && curElIdx <= potentialForwardLocs[2] + 3) {
+                refForward(potentialForwardLocs[2], curElIdx);
+            } else if (canStillForward) {
+                refForward(potentialForwardLocs[2], curElIdx);
+                refEl tmpEl_1 = refRob[curElIdx];
+                refEl tmpEl_2 = refRob[potentialForwardLocs[0]];
+                refEl tmpEl_3 = refRob[potentialForwardLocs[1]];
+                refRob.erase(refRob.begin() + curElIdx);
+                refRob.erase(refRob.begin() + potentialForwardLocs[0]);
+                refRob.erase(refRob.begin() + potentialForwardLocs[1]);
+                refRob.insert(refRob.begin() + potentialForwardLocs[2] + 1, tmpEl_3);
+                refRob.insert(refRob.begin() + potentialForwardLocs[2] + 2, tmpEl_2);
+                refRob.insert(refRob.begin() + potentialForwardLocs[2] + 3, tmpEl_1);
+            } else {
+                if (curElIdx + 1 == potentialForwardLocs[0] && potentialForwardLocs[0] + 1 == potentialForwardLocs[1]) {
+                    if (refRob[potentialForwardLocs[2]].missedForwardsTo.size() == 0 && refRob[potentialForwardLocs[1] - 1].forwardsTo.size() == 0) {
+                        refForward(potentialForwardLocs[2], curElIdx);
+                        refEl tmpEl_1 = refRob[potentialForwardLocs[2]];
+                        refRob.insert(refRob.begin() + potentialForwardLocs[1] + 1, tmpEl_1);
+                        refRob.erase(refRob.begin() + potentialForwardLocs[2]);
+                    }
+                } else {
+                    refMissed(potentialForwardLocs[2], curElIdx);
+                }
+            }
+        }
+    }
+
+    if (!BASELINE && !forwarding && curElIdx == refRob.size() - 1) {
+        unsigned int moveToEndCount = 0;
+        for (unsigned int j = 0; j < potentialForwardLocs.size(); j++) {
+            if (potentialForwardLocs[j] == refRob.size()) {
+                break;
+            }
+            if (refRob[potentialForwardLocs[j]].forwardsTo.size() == 0
+                    && refRob[potentialForwardLocs[j]].forwardsFrom.size() == 0 && refRob[potentialForwardLocs[j]].missedForwardsTo.size() == 0) {
+                moveToEndCount++;
+                refForward(potentialForwardLocs[j], curElIdx);
+                refEl tmpEl_1 = refRob[potentialForwardLocs[j]];
+                refRob.insert(refRob.begin() + curElIdx - moveToEndCount, tmpEl_1);
+                refRob.erase(refRob.begin() + potentialForwardLocs[j]);
+            }
+        }
+    }
+}
+
+VOID refReset() {
+    refRob.clear();
+    refForwardCount = 0;
+    refMissCount = 0;
+    lockstepDiverged = false;
+    lockstepChecked = 0;
+}
+
+// Print both models' entries around position at (the tail when at is past the end)
+VOID lockstepContext(std::ostream& out, unsigned int at) {
+    const unsigned int depth = 4;
+    if (at >= refRob.size()) {
+        at = refRob.size() > 0 ? refRob.size() - 1 : 0;
+    }
+    unsigned int first = at > depth ? at - depth : 0;
+    out << "  engine from position " << first << ":";
+    unsigned int i = 0;
+    for (UINT32 s = robHead; s != ROB_NIL && i <= at + depth; s = rob[s].next, i++) {
+        if (i < first) {
+            continue;
+        }
+        out << " " << rob[s].seq << "(from";
+        for (unsigned int k = 0; k < rob[s].forwardsFrom.size(); k++) {
+            out << " " << rob[s].forwardsFrom[k].seq;
+        }
+        out << ")";
+    }
+    out << std::endl << "  reference from position " << first << ":";
+    for (i = first; i < refRob.size() && i <= at + depth; i++) {
+        out << " " << refRob[i].seq << "(from";
+        for (unsigned int k = 0; k < refRob[i].forwardsFrom.size(); k++) {
+            out << " " << refRob[i].forwardsFrom[k].seq;
+        }
+        out << ")";
+    }
+    out << std::endl;
+}
+
+VOID lockstepReport(std::ostream& out, const insInfo* info, const char* what, unsigned int at) {
+    lockstepDiverged = true;
+    out << "Lockstep divergence at instruction " << iCount << ": " << what << std::endl;
+    out << "  operands:";
+    for (unsigned int i = 0; i < info->operandVals.size(); i++) {
+        const operandVal& val = info->operandVals[i];
+        if (val.isValid == 1) {
+            out << " reg" << (UINT32)val.regName;
+        } else if (val.isValid == 2) {
+            out << " mem" << val.memAddr;
+        } else {
+            out << " -";
+        }
+    }
+    out << std::endl;
+    out << "  forwards engine " << forwardCount << " reference " << refForwardCount
+        << ", misses engine " << missCount << " reference " << refMissCount << std::endl;
+    lockstepContext(out, at);
+}
+
+// Run one instruction through the engine and the reference and compare the
+// forwards it got, the running counts and, when the engine's ROB is fully
+// drained, the issue order. Returns false on the first divergence.
+bool lockstepIns(const insInfo* info, std::ostream& out) {
+    bool slow = runIns(info);
+    if (lockstepDiverged) {
+        return false;
+    }
+    refCheckDependency(info, iCount);
+    lockstepChecked++;
+
+    if (forwardCount != refForwardCount || missCount != refMissCount) {
+        lockstepReport(out, info, "forward or miss count differs", refIndexOf(iCount));
+        return false;
+    }
+    if (!slow) {
+        // Pending in the engine; the reference must not have forwarded it either
+        if (refAt(iCount).forwardsFrom.size() != 0) {
+            lockstepReport(out, info, "reference forwarded a filtered instruction", refIndexOf(iCount));
+            return false;
+        }
+        return true;
+    }
+
+    unsigned int i = 0;
+    for (UINT32 s = robHead; s != ROB_NIL; s = rob[s].next, i++) {
+        if (i >= refRob.size() || rob[s].seq != refRob[i].seq) {
+            lockstepReport(out, info, "ROB order differs", i);
+            return false;
+        }
+        if (rob[s].seq != iCount) {
+            continue;
+        }
+        const vector<refLink>& refFrom = refRob[i].forwardsFrom;
+        bool same = rob[s].forwardsFrom.size() == refFrom.size();
+        for (unsigned int k = 0; same && k < refFrom.size(); k++) {
+            same = rob[s].forwardsFrom[k].seq == refFrom[k].seq;
+        }
+        if (!same) {
+            lockstepReport(out, info, "forward sources differ", i);
+            return false;
+        }
+    }
+    if (i != refRob.size()) {
+        lockstepReport(out, info, "ROB size differs", i);
+        return false;
+    }
+    return true;
+}
+
+#endif
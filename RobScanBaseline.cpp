@@ -1,55 +1,32 @@
 #include <iostream>
 #include <fstream>
-#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "pin.H"
 using std::cerr;
 using std::endl;
 using std::ios;
 using std::ofstream;
 using std::string;
-using std::vector;
-#include <algorithm>
 
 ofstream OutFile;
 #define BUFFER_SIZE 256
 #define BASELINE 1
+#include "RobEngine.h"
+#include "RobReference.h"
+#include "BranchPredictor.h"
+#include "Lsq.h"
+#include "LookaheadScheduler.h"
+#include "CacheModel.h"
+#include "StatsShm.h"
+#include "Sketch.h"
 
-struct robEl {
-    INS inst;
-    REG regDest = REG_INVALID();
-    UINT32 memDest = 0;
-    // hasDest: 0 = invalid, 1 = reg, 2 = mem
-    int hasDest = 0;
-    vector<INS> forwardsTo;
-    vector<INS> forwardsFrom;
-    vector<INS> missedForwardsTo;
-};
-
-struct operandVal {
-    // isValid: 0 = invalid, 1 = reg, 2 = mem
-    int isValid = 0;
-    REG regName = REG_INVALID();
-    UINT32 memAddr = 0;
-};
-
-// The running count of instructions is kept here
-// make it static to help the compiler optimize docount
-static UINT64 forwardCount = 0;
-static UINT64 iCount = 0;
-vector<robEl> rob;
-
-// This function is called before every instruction is executed
-VOID checkDependency(INS ins) {
-    robEl curEl;
-    curEl.inst = ins;
-    vector<operandVal> operandVals;
-
-    iCount++;
-    // Ensure buffer does not exceed BUFFER_SIZE
-     if (rob.size() == BUFFER_SIZE) {
-        rob.erase(rob.begin());
-    }
+KNOB< string > KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "RobScanBaseline.out", "specify output file name");
 
+insInfo* decodeIns(INS ins) {
+    insInfo* info = new insInfo;
+    info->pc = INS_Address(ins);
     for (unsigned int i = 0; i < INS_OperandCount(ins); i++) {
         operandVal newVal;
         // get dest and src (if present)
@@ -59,289 +36,289 @@ VOID checkDependency(INS ins) {
             newVal.memAddr = 0;
             if (i == 0) {
                 // First operand is destination. Make it the inst's destination
-                curEl.hasDest = 1;
-                curEl.regDest = INS_OperandReg(ins, i);
-                curEl.memDest = 0;
+                info->hasDest = 1;
+                info->regDest = newVal.regName;
+                info->memDest = 0;
             }
-            } else if (INS_OperandIsMemory(ins, i)) {
+        } else if (INS_OperandIsMemory(ins, i)) {
             newVal.isValid = 2;
             newVal.memAddr = INS_OperandMemoryDisplacement(ins, i) + INS_OperandMemoryBaseReg(ins, i)
                                         + INS_OperandMemoryIndexReg(ins, i) * INS_OperandMemoryScale(ins, i);
             newVal.regName = REG_INVALID();
             if (i == 0) {
                 // First operand is destination. Make it the inst's destination
-                curEl.hasDest = 2;
-                curEl.regDest = REG_INVALID();
-                curEl.memDest = INS_OperandMemoryDisplacement(ins, i) + INS_OperandMemoryBaseReg(ins, i)
-                                        + INS_OperandMemoryIndexReg(ins, i) * INS_OperandMemoryScale(ins, i);
-            }
-        }
-        operandVals.push_back(newVal);
-    }
-
-    if (operandVals.size() > 0) {
-        vector<unsigned int> potentialForwardLocs(operandVals.size(), rob.size() + 1);
-        vector<unsigned int> prevPotentialForwardLocs(operandVals.size(), rob.size() + 1);
-
-        for (unsigned int i = 0; i < rob.size(); i++) {
-            // Go through each operand value of cur ins and see if match any previous dest
-            for (unsigned int j = 0; j < operandVals.size(); j++) {
-                // std::cout << rob[i].hasDest << " " << operandVals[j].isValid << std::endl;
-                if ((rob[i].hasDest == 1 && operandVals[j].isValid == 1 && rob[i].regDest == operandVals[j].regName)
-                        || (rob[i].hasDest == 2 && operandVals[j].isValid == 2 && rob[i].memDest == operandVals[i].memAddr)) {
-                    // Check register match
-                    // For each operand, get latest used INS
-                    prevPotentialForwardLocs[j] = potentialForwardLocs[j];
-                    potentialForwardLocs[j] = i;
-                }
+                info->hasDest = 2;
+                info->regDest = REG_INVALID();
+                info->memDest = newVal.memAddr;
             }
         }
+        info->operandVals.push_back(newVal);
+    }
 
-        // Ignore all potential locs if any other operand's potential locs have RAW after the checking potential loc
-        for (unsigned int i = 0; i < potentialForwardLocs.size(); i++) {
-            for (unsigned int j = 0; j < prevPotentialForwardLocs.size(); j++) {
-                if (i == j || potentialForwardLocs[i] == rob.size() + 1 || prevPotentialForwardLocs[j] == rob.size() + 1) {
-                    continue;
-                }
-                if (potentialForwardLocs[i] < prevPotentialForwardLocs[j]) {
-                    potentialForwardLocs[i] = rob.size() + 1;
-                }
-            }
-        }
-        
-        rob.push_back(curEl);
-        unsigned int curElIdx = rob.size() - 1;
-        bool canStillForward = false;
-        bool forwarding = false;
-
-        // Bring cur INS to latest potential forward loc + 1
-        // IF pot forward loc has availability (toForward size < 3)
-        std::sort(potentialForwardLocs.begin(), potentialForwardLocs.end(), std::greater<int>());
-
-        // 1. Furthest from EX first
-        if (potentialForwardLocs[0] == rob.size()) {
-            return;
-        } else if (potentialForwardLocs[0] > rob.size() - 5) {
-            // EDGE CASE: best forward loc already being forwarded by default
-            rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[0]].inst);
-            rob[potentialForwardLocs[0]].forwardsTo.push_back(ins);
-            forwardCount++;
-            forwarding = true;
-            if (rob[potentialForwardLocs[0]].forwardsTo.size() == 1 && rob[potentialForwardLocs[0]].forwardsFrom.size() == 0) {
-                canStillForward = true;
-            }
-        } else if (!BASELINE && rob[potentialForwardLocs[0]].forwardsTo.size() < 3) {
-            unsigned int bestIdx = rob.size();
-            // Check if potForward INS has space to accomodate
-            // Bool is true when next 2 inst has dependency but 2nd inst after does not depend on potForward INS            
-            for (unsigned int j = potentialForwardLocs[0] + 3; j > potentialForwardLocs[0]; j--) {
-                if (j > rob.size() - 2) {
-                    continue;
-                }
-                if (rob[j].forwardsFrom.size() == 0) {
-                    bestIdx = std::min(j, bestIdx);
-                } else if (rob[j].forwardsTo.size() > 0) {
-                    if (rob[j].forwardsTo.size() == 1 && j == potentialForwardLocs[0] + 1 && rob[j].forwardsTo[0] == rob[j + 1].inst) {
-                        continue;
-                    }
-                    // if this spot's instruction is forwarding to another inst, reset bestIdx to prevent dislodging its forwarding.
-                    bestIdx = rob.size();
-                }
-            }
+    finishInsInfo(info);
+    return info;
+}
 
-            if (rob[potentialForwardLocs[0]].forwardsTo.size() == 0) {
-                if (potentialForwardLocs[0] + 1 <= rob.size() - 3 && rob[potentialForwardLocs[0] + 1].forwardsFrom.size() == 0) {
-                    if (potentialForwardLocs[0] + 2 <= rob.size() - 4 && 
-                            (rob[potentialForwardLocs[0] + 2].forwardsFrom.size() == 0 || 
-                            (rob[potentialForwardLocs[0] + 2].forwardsFrom.size() == 1 && rob[potentialForwardLocs[0] + 2].forwardsFrom[0] != rob[potentialForwardLocs[0] + 1].inst))) {
-                        bestIdx = potentialForwardLocs[0] + 1;
-                    }
-                }
-            }
+KNOB< string > KnobBranchPredictor(KNOB_MODE_WRITEONCE, "pintool", "bp", "none", "branch predictor to count mispredicts with: none, bimodal, gshare, tage");
+KNOB< BOOL > KnobBranchFlush(KNOB_MODE_WRITEONCE, "pintool", "bp_flush", "0", "flush the ROB window on every mispredict of the -bp predictor");
+KNOB< BOOL > KnobLsq(KNOB_MODE_WRITEONCE, "pintool", "lsq", "0", "model the load/store queues with store-to-load forwarding (implied by -cache)");
+KNOB< UINT32 > KnobLoadQueue(KNOB_MODE_WRITEONCE, "pintool", "lq", "72", "load queue capacity");
+KNOB< UINT32 > KnobStoreQueue(KNOB_MODE_WRITEONCE, "pintool", "sq", "56", "store queue capacity");
+KNOB< BOOL > KnobCache(KNOB_MODE_WRITEONCE, "pintool", "cache", "0", "model L1/L2 data caches and classify store-to-load forwards by the latency they avoid (turns on -lsq)");
+KNOB< UINT32 > KnobL1Size(KNOB_MODE_WRITEONCE, "pintool", "l1_size", "32", "L1 data cache size in KB");
+KNOB< UINT32 > KnobL1Assoc(KNOB_MODE_WRITEONCE, "pintool", "l1_assoc", "8", "L1 data cache associativity (at most 16)");
+KNOB< UINT32 > KnobL2Size(KNOB_MODE_WRITEONCE, "pintool", "l2_size", "256", "L2 cache size in KB");
+KNOB< UINT32 > KnobL2Assoc(KNOB_MODE_WRITEONCE, "pintool", "l2_assoc", "8", "L2 cache associativity (at most 16)");
+KNOB< string > KnobStatsFile(KNOB_MODE_WRITEONCE, "pintool", "stats", "", "publish live counters to this memory-mapped file (read with RobScanMonitor)");
+KNOB< UINT64 > KnobPublishInterval(KNOB_MODE_WRITEONCE, "pintool", "publish", "10000000", "instructions between live counter publishes");
+KNOB< BOOL > KnobProfile(KNOB_MODE_WRITEONCE, "pintool", "profile", "0", "approximate per-PC forwards/misses and per-line store-to-load forwards/L1 misses in fixed-size sketches");
+KNOB< UINT32 > KnobSketchBudget(KNOB_MODE_WRITEONCE, "pintool", "sketch_kb", "256", "memory budget in KB shared by the profile sketches, top-K tables included");
+KNOB< UINT32 > KnobTopK(KNOB_MODE_WRITEONCE, "pintool", "topk", "20", "heaviest keys reported per profile (at most 64)");
+KNOB< UINT32 > KnobLookahead(KNOB_MODE_WRITEONCE, "pintool", "lookahead", "0", "also run the lookahead batch model over batches of this many instructions, for comparison (0 = off)");
+KNOB< BOOL > KnobCheck(KNOB_MODE_WRITEONCE, "pintool", "check", "0", "run the reference model in lockstep and report the first divergence");
+
+// Approximate profiles: forwards and missed forwards keyed by the consumer's PC,
+// store-to-load forwards and L1 misses keyed by cache line
+static countMinSketch pcForwardSketch;
+static countMinSketch pcMissSketch;
+static countMinSketch lineForwardSketch;
+static countMinSketch lineMissSketch;
+// Knob values read on every memory access, cached like lsqEnabled
+static bool profileEnabled = false;
+
+// The line sketches are only kept when their source is modelled: store-to-load
+// forwards need the queues, L1 misses the cache. Each kept sketch gets an equal
+// share of the budget left after the top-K tables. False when that share is below
+// the narrowest sketch.
+bool profileReset(UINT32 budgetKB, UINT32 topK, bool lineForwards, bool lineMisses) {
+    UINT32 sketches = 2 + (lineForwards ? 1 : 0) + (lineMisses ? 1 : 0);
+    UINT64 topBytes = sketches * sizeof(pcForwardSketch.top);
+    UINT64 budget = (UINT64)budgetKB * 1024;
+    UINT64 bytes = (budget > topBytes) ? (budget - topBytes) / sketches : 0;
+    if (bytes < SKETCH_MIN_BYTES) {
+        return false;
+    }
+    profileEnabled = true;
+    sketchInit(pcForwardSketch, "Forwards by PC", bytes, topK);
+    sketchInit(pcMissSketch, "Missed forwards by PC", bytes, topK);
+    if (lineForwards) {
+        sketchInit(lineForwardSketch, "Store-to-load forwards by line", bytes, topK);
+    }
+    if (lineMisses) {
+        sketchInit(lineMissSketch, "L1 misses by line", bytes, topK);
+    }
+    return true;
+}
 
-            if (bestIdx == rob.size()) {
-                rob[potentialForwardLocs[0]].missedForwardsTo.push_back(ins);
-            } else {
-                // have space at bestIdx
-                rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[0]].inst);
-                rob[potentialForwardLocs[0]].forwardsTo.push_back(ins);
-                robEl tmpEl = rob[curElIdx];
-                rob.erase(rob.begin() + curElIdx);
-                rob.insert(rob.begin() + bestIdx, tmpEl);
-                forwardCount++;
-                forwarding = true;
-                curElIdx = bestIdx;
-                if (rob[potentialForwardLocs[0]].forwardsTo.size() == 1 && rob[potentialForwardLocs[0]].forwardsFrom.size() == 0) {
-                    canStillForward = true;
-                } 
-            }
-        } else {
-            rob[potentialForwardLocs[0]].missedForwardsTo.push_back(ins);
-        }
+// Then-calls used instead of forwardDependency/checkAllDependency while profiling
+VOID PIN_FAST_ANALYSIS_CALL forwardDependencyProfiled(const insInfo* info) {
+    UINT64 forwardsBefore = forwardCount;
+    UINT64 missesBefore = missCount;
+    forwardDependency(info);
+    sketchAdd(pcForwardSketch, info->pc, forwardCount - forwardsBefore);
+    sketchAdd(pcMissSketch, info->pc, missCount - missesBefore);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL checkAllDependencyProfiled(const insInfo* info) {
+    recordIns(info);
+    forwardDependencyProfiled(info);
+}
 
-        // 2. Check if second forwarding exist/possible
-        if (potentialForwardLocs.size() <= 1 || (potentialForwardLocs.size() > 1 && potentialForwardLocs[1] == rob.size())) {
-            return;
+// Memory reads: a load forwarded from an in-flight store skips the cache and is
+// credited with the latency of the level the store found its line in; any other
+// load accesses the cache, and its level goes to the engine so the ROB forwards
+// from it can be weighted too
+VOID memRead(ADDRINT addr, UINT32 size) {
+    UINT32 forwardLevel = lsqEnabled ? lsqLoad(addr, size) : LSQ_NO_FORWARD;
+    if (forwardLevel != LSQ_NO_FORWARD && profileEnabled) {
+        sketchAdd(lineForwardSketch, addr >> CACHE_LINE_SHIFT, 1);
+    }
+    if (!cacheEnabled) {
+        return;
+    }
+    if (forwardLevel != LSQ_NO_FORWARD) {
+        stlfByLevel[forwardLevel]++;
+    } else {
+        UINT32 level = cacheAccess(addr);
+        loadsByLevel[level]++;
+        // An instruction with several reads waits for the slowest
+        robLoadLevel& load = loadLevels[iCount % BUFFER_SIZE];
+        if (load.seq != iCount || load.level < level) {
+            load.seq = iCount;
+            load.level = level;
         }
-        // Check if can still forward to next target with both cur inst and latest target back to back
-        // Means next target must have space to accomdate two inst
-            // Check if next target already forwarding...
-        if (curElIdx > potentialForwardLocs[1] && curElIdx <= potentialForwardLocs[1] + 3) {
-            rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[1]].inst);
-            rob[potentialForwardLocs[1]].forwardsTo.push_back(ins);
-            forwardCount++;
-            if (!(rob[potentialForwardLocs[1]].forwardsTo.size() == 1 && rob[potentialForwardLocs[1]].forwardsFrom.size() == 0)) {
-                canStillForward = false;
-            }
-        } else if (forwarding && canStillForward && potentialForwardLocs[1] != potentialForwardLocs[0]) {
-            if (!BASELINE && rob[potentialForwardLocs[1]].forwardsTo.size() < 2) {
-                bool noForwards = true;
-                for (unsigned int j = potentialForwardLocs[0] + 1; j < potentialForwardLocs[0] + 3 || j < rob.size() - 2; j++) {
-                    if (rob[j].forwardsFrom.size() != 0) {
-                        noForwards = false;
-                    }
-                }
-                if (potentialForwardLocs[1] + 2 < rob.size() - 2 &&
-                        rob[potentialForwardLocs[1] + 2].forwardsFrom.size() == 1 && rob[potentialForwardLocs[1] + 2].forwardsFrom[0] == rob[potentialForwardLocs[1] + 1].inst) {
-                    noForwards = true;
-                }
-                if (noForwards) {
-                    rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[1]].inst);
-                    rob[potentialForwardLocs[1]].forwardsTo.push_back(ins);
-                    robEl tmpEl_1 = rob[curElIdx];
-                    robEl tmpEl_2 = rob[potentialForwardLocs[0]];
-                    rob.erase(rob.begin() + curElIdx);
-                    rob.erase(rob.begin() + potentialForwardLocs[0]);
-                    rob.insert(rob.begin() + potentialForwardLocs[1] + 1, tmpEl_2);
-                    rob.insert(rob.begin() + potentialForwardLocs[1] + 2, tmpEl_1);
-                    forwardCount++;
-                    potentialForwardLocs[0] = potentialForwardLocs[1] + 1;
-                    curElIdx = potentialForwardLocs[1] + 2;
-                    if (rob[potentialForwardLocs[1]].forwardsTo.size() == 1 && rob[potentialForwardLocs[1]].forwardsFrom.size() == 0) {
-                        canStillForward = true;
-                    } else {
-                        canStillForward = false;
-                    }
-                } else if (potentialForwardLocs[1] + 2 < rob.size() - 2 && potentialForwardLocs[1] - 1 >= 0 && rob[potentialForwardLocs[1] + 2].forwardsFrom.size() == 0 && 
-                        rob[potentialForwardLocs[1] + 1].forwardsFrom.size() == 1 && rob[potentialForwardLocs[1] + 1].forwardsFrom[1] == rob[potentialForwardLocs[1] - 1].inst) {
-                    rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[1]].inst);
-                    rob[potentialForwardLocs[1]].forwardsTo.push_back(ins);
-                    robEl tmpEl_1 = rob[curElIdx];
-                    robEl tmpEl_2 = rob[potentialForwardLocs[0]];
-                    rob.erase(rob.begin() + curElIdx);
-                    rob.erase(rob.begin() + potentialForwardLocs[0]);
-                    rob.insert(rob.begin() + potentialForwardLocs[1] - 1, tmpEl_2);
-                    rob.insert(rob.begin() + potentialForwardLocs[1] + 1, tmpEl_1);
-                    forwardCount++;
-                    potentialForwardLocs[0] = potentialForwardLocs[1] - 1;
-                    curElIdx = potentialForwardLocs[1] + 1;
-                    if (rob[potentialForwardLocs[1]].forwardsTo.size() == 1 && rob[potentialForwardLocs[1]].forwardsFrom.size() == 0) {
-                        canStillForward = true;
-                    }  else {
-                        canStillForward = false;
-                    }
-                } else {
-                    canStillForward = false;
-                }
-            } else {
-                rob[potentialForwardLocs[1]].missedForwardsTo.push_back(ins);
-                canStillForward = false;
-            }
-        } else {
-            rob[potentialForwardLocs[1]].missedForwardsTo.push_back(ins);
-            canStillForward = false;
+        if (profileEnabled && level != LEVEL_L1) {
+            sketchAdd(lineMissSketch, addr >> CACHE_LINE_SHIFT, 1);
         }
+    }
+}
 
-        // 3. Check if third forwarding exist/possible
-        if (potentialForwardLocs.size() <= 2 || (potentialForwardLocs.size() > 2 && potentialForwardLocs[2] == rob.size())) {
-            return;
-        }
+VOID memWrite(ADDRINT addr, UINT32 size) {
+    // The level before the store fills its line is what a forwarded load avoids
+    UINT32 level = LEVEL_L1;
+    if (cacheEnabled) {
+        level = cacheAccess(addr);
+        storesByLevel[level]++;
+    }
+    if (lsqEnabled) {
+        lsqStore(addr, size, level);
+    }
+}
 
-        if (curElIdx > potentialForwardLocs[2] && curElIdx <= potentialForwardLocs[2] + 3) {
-            rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[2]].inst);
-            rob[potentialForwardLocs[2]].forwardsTo.push_back(ins);
-            forwardCount++;
-        } else if (!BASELINE && forwarding && canStillForward && potentialForwardLocs[2] != potentialForwardLocs[1]) {
-            if (rob[potentialForwardLocs[2]].forwardsTo.size() == 0) {
-                for (unsigned int i = potentialForwardLocs[2] + 1; i < potentialForwardLocs[2] + 3 || i < rob.size() - 2; i++) {
-                    if (rob[i].forwardsFrom.size() > 0) {
-                        canStillForward = false;
-                        break;
-                    }
-                }
-
-                if (curElIdx > potentialForwardLocs[2] && curElIdx <= potentialForwardLocs[2] + 3) {
-                    rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[2]].inst);
-                    rob[potentialForwardLocs[2]].forwardsTo.push_back(ins);
-                    forwardCount++;
-                } else if (!BASELINE && canStillForward) {
-                    // next 3 INS from third forwarding has no forwardFrom. So move both cur ins and its previous dependent up
-                    rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[2]].inst);
-                    rob[potentialForwardLocs[2]].forwardsTo.push_back(ins);
-                    robEl tmpEl_1 = rob[curElIdx];
-                    robEl tmpEl_2 = rob[potentialForwardLocs[0]];
-                    robEl tmpEl_3 = rob[potentialForwardLocs[1]];
-                    rob.erase(rob.begin() + curElIdx);
-                    rob.erase(rob.begin() + potentialForwardLocs[0]);
-                    rob.erase(rob.begin() + potentialForwardLocs[1]);
-                    rob.insert(rob.begin() + potentialForwardLocs[2] + 1, tmpEl_3);
-                    rob.insert(rob.begin() + potentialForwardLocs[2] + 2, tmpEl_2);
-                    rob.insert(rob.begin() + potentialForwardLocs[2] + 3, tmpEl_1);
-                    forwardCount++;
-                } else {
-                    // move last target down if possible
-                    if (curElIdx + 1 == potentialForwardLocs[0] && potentialForwardLocs[0] + 1 == potentialForwardLocs[1]) {
-                        if (rob[potentialForwardLocs[2]].missedForwardsTo.size() == 0 && rob[potentialForwardLocs[1] - 1].forwardsTo.size() == 0) {
-                            rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[2]].inst);
-                            rob[potentialForwardLocs[2]].forwardsTo.push_back(ins);
-                            robEl tmpEl_1 = rob[potentialForwardLocs[2]];
-                            rob.insert(rob.begin() + potentialForwardLocs[1] + 1, tmpEl_1);
-                            rob.erase(rob.begin() + potentialForwardLocs[2]);
-                            forwardCount++;
-                        }
-                    } else {
-                        rob[potentialForwardLocs[2]].missedForwardsTo.push_back(ins);
-                    }
-                }
-            }
-        }
+// Live statistics. The hot path only bumps the executing thread's own counter
+// (aligned and padded to a cache line); everything is copied out once per publish interval.
+struct alignas(64) threadCounter {
+    UINT64 insCount;
+    UINT8 pad[56];
+};
+static threadCounter threadCounters[ROBSTATS_MAX_THREADS];
+static robStatsShm* statsShm = NULL;
+static UINT64 nextPublish = ~0ULL;
+static UINT64 lastPublishICount = 0;
+static UINT64 lastPublishForwardCount = 0;
+static UINT64 lastPublishMissCount = 0;
+static UINT32 maxThreadId = 0;
+// Makes exactly one thread the seqlock writer for each publish
+static PIN_LOCK publishLock;
+
+// If-call at every basic block: count its instructions for the thread, nonzero when a publish is due
+ADDRINT PIN_FAST_ANALYSIS_CALL countBbl(THREADID tid, UINT32 numIns) {
+    threadCounters[tid % ROBSTATS_MAX_THREADS].insCount += numIns;
+    return iCount >= nextPublish;
+}
 
-        if (!BASELINE && !forwarding && curElIdx == rob.size() - 1) {
-            int moveToEndCount = 0;
-            for (unsigned int j = 0; j < potentialForwardLocs.size(); j++) {
-                if (potentialForwardLocs[j] == rob.size()) {
-                    break;
-                }
-                if (rob[potentialForwardLocs[j]].forwardsTo.size() == 0
-                        && rob[potentialForwardLocs[j]].forwardsFrom.size() == 0 && rob[potentialForwardLocs[j]].missedForwardsTo.size() == 0) {
-                    moveToEndCount++;
-                    rob[curElIdx].forwardsFrom.push_back(rob[potentialForwardLocs[j]].inst);
-                    rob[potentialForwardLocs[j]].forwardsTo.push_back(ins);
-                    robEl tmpEl_1 = rob[potentialForwardLocs[j]];
-                    rob.insert(rob.begin() + curElIdx - moveToEndCount, tmpEl_1);
-                    rob.erase(rob.begin() + potentialForwardLocs[j]);
-                    forwardCount++;
-                }
-            }
-        }
+VOID publishStats(BOOL done) {
+    UINT64 intervalIns = iCount - lastPublishICount;
+    statsBeginWrite(statsShm);
+    statsShm->publishCount++;
+    statsShm->done = done ? 1 : 0;
+    statsShm->threadCount = std::min(maxThreadId + 1, (UINT32)ROBSTATS_MAX_THREADS);
+    statsShm->iCount = iCount;
+    statsShm->forwardCount = forwardCount;
+    statsShm->missCount = missCount;
+    statsShm->regForwardCount = regForwardCount;
+    statsShm->memForwardCount = memForwardCount;
+    statsShm->bpFlush = bpFlush ? 1 : 0;
+    statsShm->branchCount = branchCount;
+    statsShm->mispredictCount = mispredictCount;
+    statsShm->stlfCount = stlfCount;
+    statsShm->intervalInsCount = intervalIns;
+    statsShm->intervalForwardRate = intervalIns ? double(forwardCount - lastPublishForwardCount) / double(intervalIns) : 0.0;
+    statsShm->intervalMissRate = intervalIns ? double(missCount - lastPublishMissCount) / double(intervalIns) : 0.0;
+    for (UINT32 t = 0; t < ROBSTATS_MAX_THREADS; t++) {
+        statsShm->threadInsCount[t] = threadCounters[t].insCount;
+    }
+    statsEndWrite(statsShm);
 
-        operandVals.clear();
-        return;
+    lastPublishICount = iCount;
+    lastPublishForwardCount = forwardCount;
+    lastPublishMissCount = missCount;
+    nextPublish = iCount + KnobPublishInterval.Value();
+}
+
+// Then-call for countBbl. Several threads can find the same publish due; the first
+// to take the lock publishes and moves nextPublish on, so the rest find it done.
+VOID PIN_FAST_ANALYSIS_CALL publishDue(THREADID tid) {
+    PIN_GetLock(&publishLock, tid + 1);
+    if (iCount >= nextPublish) {
+        publishStats(false);
+    }
+    PIN_ReleaseLock(&publishLock);
+}
+
+bool openStatsFile(const string& path) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, sizeof(robStatsShm)) != 0) {
+        close(fd);
+        return false;
+    }
+    VOID* mem = mmap(NULL, sizeof(robStatsShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    statsShm = (robStatsShm*)mem;
+    memset(statsShm, 0, sizeof(robStatsShm));
+    statsShm->magic = ROBSTATS_MAGIC;
+    statsShm->version = ROBSTATS_VERSION;
+    statsShm->pid = getpid();
+    nextPublish = KnobPublishInterval.Value();
+    return true;
+}
+
+VOID ThreadStart(THREADID tid, CONTEXT* ctxt, INT32 flags, VOID* v) {
+    maxThreadId = std::max(maxThreadId, (UINT32)tid);
+}
+
+// Pin calls this function for every new trace; only used for live statistics
+VOID Trace(TRACE trace, VOID* v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        BBL_InsertIfCall(bbl, IPOINT_BEFORE, (AFUNPTR)countBbl, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID,
+                         IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+        BBL_InsertThenCall(bbl, IPOINT_BEFORE, (AFUNPTR)publishDue, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_END);
     }
+}
 
-    
-    rob.push_back(curEl);
-    operandVals.clear();
+// Check mode: every instruction goes through both models
+VOID checkLockstep(const insInfo* info) {
+    lockstepIns(info, OutFile);
 }
 
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID* v)
 {
-    // Insert a call to docount before every instruction, no arguments are passed
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)checkDependency, IARG_UINT32, ins, IARG_END);
+    insInfo* info = decodeIns(ins);
+
+    if (KnobCheck.Value()) {
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)checkLockstep, IARG_PTR, info, IARG_END);
+    } else if (info->path == PATH_RECORD) {
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)recordIns, IARG_FAST_ANALYSIS_CALL, IARG_PTR, info, IARG_END);
+    } else if (info->path == PATH_ALWAYS) {
+        AFUNPTR checkAll = profileEnabled ? (AFUNPTR)checkAllDependencyProfiled : (AFUNPTR)checkAllDependency;
+        INS_InsertCall(ins, IPOINT_BEFORE, checkAll, IARG_FAST_ANALYSIS_CALL, IARG_PTR, info, IARG_END);
+    } else {
+        AFUNPTR forward = profileEnabled ? (AFUNPTR)forwardDependencyProfiled : (AFUNPTR)forwardDependency;
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)mayForward, IARG_FAST_ANALYSIS_CALL, IARG_PTR, info, IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, forward, IARG_FAST_ANALYSIS_CALL, IARG_PTR, info, IARG_END);
+    }
+
+    if (lookaheadSize != 0) {
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)lookaheadRecord, IARG_FAST_ANALYSIS_CALL, IARG_PTR, info, IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)lookaheadSchedule, IARG_FAST_ANALYSIS_CALL, IARG_END);
+    }
+
+    if (lsqEnabled) {
+        // Reads before writes so an instruction never forwards to itself
+        for (UINT32 i = 0; i < INS_MemoryOperandCount(ins); i++) {
+            if (INS_MemoryOperandIsRead(ins, i)) {
+                INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)memRead, IARG_MEMORYOP_EA, i,
+                                         IARG_UINT32, INS_MemoryOperandSize(ins, i), IARG_END);
+            }
+        }
+        for (UINT32 i = 0; i < INS_MemoryOperandCount(ins); i++) {
+            if (INS_MemoryOperandIsWritten(ins, i)) {
+                INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)memWrite, IARG_MEMORYOP_EA, i,
+                                         IARG_UINT32, INS_MemoryOperandSize(ins, i), IARG_END);
+            }
+        }
+    }
+
+    // Conditional branches and indirect control flow can mispredict; inserted after the
+    // ROB call so the branch itself is on the older side of a flush
+    bool conditional = INS_IsBranch(ins) && INS_HasFallThrough(ins);
+    if (bpKind != BP_NONE && (conditional || (INS_IsControlFlow(ins) && !INS_IsDirectBranchOrCall(ins)))) {
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)branchResolve, IARG_INST_PTR, IARG_BRANCH_TAKEN,
+                       IARG_BRANCH_TARGET_ADDR, IARG_BOOL, conditional, IARG_BOOL, INS_IsRet(ins), IARG_END);
+    }
+    if (bpKind != BP_NONE && INS_IsCall(ins)) {
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)rasPush, IARG_ADDRINT, INS_NextAddress(ins), IARG_END);
+    }
 }
 
-KNOB< string > KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "RobScanBaseline.out", "specify output file name");
 
 // This function is called when the application exits
 VOID Fini(INT32 code, VOID* v)
@@ -349,9 +326,80 @@ VOID Fini(INT32 code, VOID* v)
     // Write to a file since cout and cerr maybe closed by the application
     OutFile.setf(ios::showbase);
     OutFile << "Forwarding count " << forwardCount << endl;
+    OutFile << "Missed forwarding count " << missCount << endl;
     OutFile << "Total inst count " << iCount << endl;
     OutFile << "Forwarding Potential " << float(forwardCount)/float(iCount) << endl;
+    OutFile << "Register forwarding count " << regForwardCount << endl;
+    OutFile << "Memory forwarding count " << memForwardCount << endl;
+    if (lookaheadSize != 0) {
+        OutFile << "Lookahead window " << lookaheadSize << " (" << lookaheadBatches << " batches)" << endl;
+        // Two models with different forward rules, so the ratio is not a gap to an optimum
+        OutFile << "Lookahead batch model forwarding count " << lookaheadForwardCount << endl;
+        OutFile << "Greedy ROB model forwarding count over the same instructions " << greedyBatchForwardCount << endl;
+        OutFile << "Greedy ROB / lookahead batch model forwarding ratio " << float(greedyBatchForwardCount)/float(lookaheadForwardCount) << endl;
+    }
+    if (lsqEnabled) {
+        OutFile << "Load count " << loadCount << endl;
+        OutFile << "Store count " << storeCount << endl;
+        OutFile << "Store-to-load forwarding count " << stlfCount << endl;
+        OutFile << "Partial store-to-load overlap count " << stlfPartialCount << endl;
+        OutFile << "Load queue full stalls " << lqFullStalls << " (capacity " << lqCapacity << ")" << endl;
+        OutFile << "Store queue full stalls " << sqFullStalls << " (capacity " << sqCapacity << ")" << endl;
+        OutFile << "Forwarding Potential with LSQ " << float(regForwardCount + stlfCount)/float(iCount) << endl;
+    }
+    if (cacheEnabled) {
+        UINT64 cyclesAvoided = 0;
+        OutFile << "L1 " << (l1Cache.sets * l1Cache.ways) / 16 << "KB " << l1Cache.ways << "-way, L2 "
+                << (l2Cache.sets * l2Cache.ways) / 16 << "KB " << l2Cache.ways << "-way" << endl;
+        for (UINT32 l = 0; l < CACHE_LEVELS; l++) {
+            OutFile << "Loads from " << levelName[l] << " " << loadsByLevel[l] << endl;
+            OutFile << "Stores to " << levelName[l] << " " << storesByLevel[l] << endl;
+            OutFile << "Store-to-load forwards avoiding " << levelName[l] << " latency " << stlfByLevel[l] << endl;
+            cyclesAvoided += stlfByLevel[l] * levelLatency[l];
+        }
+        OutFile << "Load latency avoided by forwarding (cycles) " << cyclesAvoided << endl;
+        // The tool's main statistic, weighted: ROB forwards whose producer is a load
+        UINT64 loadForwardCycles = 0;
+        for (UINT32 l = 0; l < CACHE_LEVELS; l++) {
+            OutFile << "ROB forwards from loads served by " << levelName[l] << " " << loadForwardsByLevel[l] << endl;
+            loadForwardCycles += loadForwardsByLevel[l] * levelLatency[l];
+        }
+        OutFile << "ROB forwards from loads weighted by load latency (cycles) " << loadForwardCycles << endl;
+    }
+    if (bpKind != BP_NONE) {
+        OutFile << "Branch count " << branchCount << endl;
+        OutFile << "Mispredict count " << mispredictCount << endl;
+        OutFile << "Mispredict rate " << float(mispredictCount)/float(branchCount) << endl;
+        // The forwarding counts above already include the flushes when they are on
+        OutFile << "ROB flushed on mispredicts " << (bpFlush ? "yes" : "no") << endl;
+    }
+    if (KnobCheck.Value()) {
+        OutFile << "Lockstep checked " << lockstepChecked << " instructions, "
+                << (lockstepDiverged ? "diverged" : "no divergence") << endl;
+    }
+    if (profileEnabled) {
+        sketchReport(OutFile, pcForwardSketch, 0);
+        sketchReport(OutFile, pcMissSketch, 0);
+        if (lsqEnabled) {
+            sketchReport(OutFile, lineForwardSketch, CACHE_LINE_SHIFT);
+        } else {
+            OutFile << "Store-to-load forwards by line: not collected, needs -lsq or -cache" << endl;
+        }
+        if (cacheEnabled) {
+            sketchReport(OutFile, lineMissSketch, CACHE_LINE_SHIFT);
+        } else {
+            OutFile << "L1 misses by line: not collected, needs -cache" << endl;
+        }
+    }
     OutFile.close();
+
+    if (statsShm != NULL) {
+        PIN_GetLock(&publishLock, PIN_ThreadId() + 1);
+        publishStats(true);
+        PIN_ReleaseLock(&publishLock);
+        munmap(statsShm, sizeof(robStatsShm));
+        statsShm = NULL;
+    }
 }
 
 /* ===================================================================== */
@@ -376,12 +424,46 @@ int main(int argc, char* argv[])
     // std::cout << "Actually started..." << std::endl;
     // Initialize pin
     if (PIN_Init(argc, argv)) return Usage();
+    // The reference is the original algorithm, which the policy fixes deliberately leave
+    if (KnobCheck.Value() && ROB_POLICY_FIXES) {
+        cerr << "-check needs a build with ROB_POLICY_FIXES 0" << endl;
+        return -1;
+    }
+    // Nor does it flush on mispredicts
+    if (KnobCheck.Value() && KnobBranchFlush.Value()) {
+        cerr << "-check cannot be combined with -bp_flush" << endl;
+        return -1;
+    }
 
     OutFile.open(KnobOutputFile.Value().c_str());
 
+    robReset();
+    bpReset(bpKindFromName(KnobBranchPredictor.Value()), KnobBranchFlush.Value());
+    // Forwards can only be classified by level when the queues are modelled
+    lsqReset(KnobLsq.Value() || KnobCache.Value(), KnobLoadQueue.Value(), KnobStoreQueue.Value());
+    lookaheadReset(KnobLookahead.Value());
+    if (KnobCache.Value()) {
+        cacheReset(KnobL1Size.Value(), KnobL1Assoc.Value(), KnobL2Size.Value(), KnobL2Assoc.Value());
+    }
+    if (KnobProfile.Value() && !profileReset(KnobSketchBudget.Value(), KnobTopK.Value(), lsqEnabled, cacheEnabled)) {
+        cerr << "-sketch_kb " << KnobSketchBudget.Value() << " is too small: each profile sketch needs "
+             << (SKETCH_MIN_BYTES + sizeof(pcForwardSketch.top)) / 1024 << "KB" << endl;
+        return -1;
+    }
+
     // Register Instruction to be called to instrument instructions
     INS_AddInstrumentFunction(Instruction, 0);
 
+    if (!KnobStatsFile.Value().empty()) {
+        if (!openStatsFile(KnobStatsFile.Value())) {
+            cerr << "Cannot map statistics file " << KnobStatsFile.Value() << endl;
+            return -1;
+        }
+        PIN_InitLock(&publishLock);
+        TRACE_AddInstrumentFunction(Trace, 0);
+        PIN_AddThreadStartFunction(ThreadStart, 0);
+    }
+
     // Register Fini to be called when the application exits
     PIN_AddFiniFunction(Fini, 0);
 
@@ -0,0 +1,89 @@
+// Prints the live counters a running RobScan publishes with -stats <file>.
+// Builds without Pin: g++ -O2 -o RobScanMonitor RobScanMonitor.cpp
+// Usage: RobScanMonitor <stats file> [seconds between reads] [-once]
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "StatsShm.h"
+using std::cerr;
+using std::cout;
+using std::endl;
+
+void printSnapshot(const robStatsShm& s) {
+    cout << "pid " << s.pid << " publish " << s.publishCount << (s.done ? " (finished)" : "") << endl;
+    cout << "  Total inst count " << s.iCount << endl;
+    cout << "  Forwarding count " << s.forwardCount << " (register " << s.regForwardCount
+         << ", memory " << s.memForwardCount << ")" << endl;
+    cout << "  Missed forwarding count " << s.missCount << endl;
+    if (s.iCount != 0) {
+        cout << "  Forwarding Potential " << double(s.forwardCount) / double(s.iCount) << endl;
+    }
+    if (s.branchCount != 0) {
+        cout << "  Mispredicts " << s.mispredictCount << " of " << s.branchCount << " branches"
+             << (s.bpFlush ? ", ROB flushed on each" : "") << endl;
+    }
+    if (s.stlfCount != 0) {
+        cout << "  Store-to-load forwarding count " << s.stlfCount << endl;
+    }
+    cout << "  Last interval: " << s.intervalInsCount << " inst, forwarding rate " << s.intervalForwardRate
+         << ", miss rate " << s.intervalMissRate << endl;
+    for (uint32_t t = 0; t < s.threadCount && t < ROBSTATS_MAX_THREADS; t++) {
+        cout << "  Thread " << t << " inst count " << s.threadInsCount[t] << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <stats file> [seconds between reads] [-once]" << endl;
+        return 1;
+    }
+    unsigned int period = (argc > 2 && std::string(argv[2]) != "-once") ? atoi(argv[2]) : 5;
+    bool once = std::string(argv[argc - 1]) == "-once";
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        cerr << "Cannot open " << argv[1] << endl;
+        return 1;
+    }
+    // Reading past the end of a short mapping raises SIGBUS, e.g. a file the tool has
+    // just truncated and not yet grown, or a stale one from an older layout
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(robStatsShm)) {
+        close(fd);
+        cerr << argv[1] << " is not a RobScan statistics file (too short)" << endl;
+        return 1;
+    }
+    void* mem = mmap(NULL, sizeof(robStatsShm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        cerr << "Cannot map " << argv[1] << endl;
+        return 1;
+    }
+    const robStatsShm* shm = (const robStatsShm*)mem;
+    if (shm->magic != ROBSTATS_MAGIC || shm->version != ROBSTATS_VERSION) {
+        cerr << argv[1] << " is not a RobScan statistics file" << endl;
+        return 1;
+    }
+
+    robStatsShm snapshot = robStatsShm();
+    bool done = false;
+    while (true) {
+        // A failed read can leave a torn copy behind, so only trust done from a good one
+        if (statsReadSnapshot(shm, &snapshot)) {
+            printSnapshot(snapshot);
+            done = snapshot.done != 0;
+        } else {
+            cerr << "Writer busy, retrying" << endl;
+        }
+        if (once || done) {
+            break;
+        }
+        sleep(period);
+    }
+    munmap(mem, sizeof(robStatsShm));
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Fixed-size approximate counters for per-PC and per-address profiles. A count-min
+// sketch (SKETCH_DEPTH rows of UINT64 counters, conservative update)
+// estimates any key's count with est - eps*N <= true <= est, eps = e/width, except
+// with probability e^-depth. A small top-K table keeps the heaviest keys seen by
+// estimate. Memory is set once at init and never grows with the workload.
+// Include after RobEngine.h.
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <ostream>
+#include <iomanip>
+#include <cmath>
+
+#define SKETCH_DEPTH 4
+#define SKETCH_MIN_WIDTH_SHIFT 6
+#define SKETCH_MAX_WIDTH_SHIFT 28
+#define SKETCH_MAX_TOPK 64
+// Counter bytes of the narrowest sketch; smaller budgets are rejected
+#define SKETCH_MIN_BYTES ((UINT64)SKETCH_DEPTH * sizeof(UINT64) << SKETCH_MIN_WIDTH_SHIFT)
+
+struct heavyHitter {
+    UINT64 key = 0;
+    UINT64 count = 0;
+};
+
+struct countMinSketch {
+    const char* name = "";
+    UINT32 width = 0;
+    UINT32 widthShift = 0;
+    // 64-bit so a hot key in a multi-billion-instruction run cannot saturate and
+    // break est >= true
+    UINT64* counters = NULL;
+    // Sum of all increments (N in the error bound)
+    UINT64 total = 0;
+    heavyHitter top[SKETCH_MAX_TOPK];
+    UINT32 topK = 0;
+    UINT32 topCount = 0;
+    // Smallest count in a full top table, and where it is
+    UINT64 topMin = 0;
+    UINT32 topMinIdx = 0;
+};
+
+// Odd multipliers for multiply-shift hashing, one per row
+static const UINT64 sketchSeeds[SKETCH_DEPTH] = {
+    0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL
+};
+
+// bytes is the counter budget; width is the largest power of two that fits. False,
+// with nothing allocated, when not even the narrowest sketch fits.
+bool sketchInit(countMinSketch& sk, const char* name, UINT64 bytes, UINT32 topK) {
+    if (bytes < SKETCH_MIN_BYTES) {
+        return false;
+    }
+    sk.name = name;
+    sk.widthShift = SKETCH_MIN_WIDTH_SHIFT;
+    while (sk.widthShift < SKETCH_MAX_WIDTH_SHIFT && ((UINT64)SKETCH_DEPTH * sizeof(UINT64) << (sk.widthShift + 1)) <= bytes) {
+        sk.widthShift++;
+    }
+    sk.width = 1U << sk.widthShift;
+    delete[] sk.counters;
+    sk.counters = new UINT64[(UINT64)SKETCH_DEPTH * sk.width];
+    for (UINT64 i = 0; i < (UINT64)SKETCH_DEPTH * sk.width; i++) {
+        sk.counters[i] = 0;
+    }
+    sk.total = 0;
+    sk.topK = std::min(topK, (UINT32)SKETCH_MAX_TOPK);
+    sk.topCount = 0;
+    sk.topMin = 0;
+    sk.topMinIdx = 0;
+    return true;
+}
+
+UINT64 sketchBytes(const countMinSketch& sk) {
+    return (UINT64)SKETCH_DEPTH * sk.width * sizeof(UINT64) + sizeof(sk.top);
+}
+
+UINT32 sketchIndex(const countMinSketch& sk, UINT32 row, UINT64 key) {
+    return row * sk.width + (UINT32)(((key + 1) * sketchSeeds[row]) >> (64 - sk.widthShift));
+}
+
+UINT64 sketchEstimate(const countMinSketch& sk, UINT64 key) {
+    UINT64 est = ~0ULL;
+    for (UINT32 r = 0; r < SKETCH_DEPTH; r++) {
+        est = std::min(est, sk.counters[sketchIndex(sk, r, key)]);
+    }
+    return est;
+}
+
+VOID sketchFindTopMin(countMinSketch& sk) {
+    sk.topMinIdx = 0;
+    for (UINT32 i = 1; i < sk.topCount; i++) {
+        if (sk.top[i].count < sk.top[sk.topMinIdx].count) {
+            sk.topMinIdx = i;
+        }
+    }
+    sk.topMin = sk.top[sk.topMinIdx].count;
+}
+
+VOID sketchAdd(countMinSketch& sk, UINT64 key, UINT32 n) {
+    if (n == 0) {
+        return;
+    }
+    sk.total += n;
+    // Conservative update: only raise counters up to the new estimate
+    UINT32 idx[SKETCH_DEPTH];
+    UINT64 est = ~0ULL;
+    for (UINT32 r = 0; r < SKETCH_DEPTH; r++) {
+        idx[r] = sketchIndex(sk, r, key);
+        est = std::min(est, sk.counters[idx[r]]);
+    }
+    UINT64 target = est + n;
+    for (UINT32 r = 0; r < SKETCH_DEPTH; r++) {
+        sk.counters[idx[r]] = std::max(sk.counters[idx[r]], target);
+    }
+
+    // Most keys stay below the table minimum and skip the scan entirely
+    if (sk.topK == 0 || (sk.topCount == sk.topK && target <= sk.topMin)) {
+        return;
+    }
+    for (UINT32 i = 0; i < sk.topCount; i++) {
+        if (sk.top[i].key == key) {
+            sk.top[i].count = target;
+            if (i == sk.topMinIdx) {
+                sketchFindTopMin(sk);
+            }
+            return;
+        }
+    }
+    UINT32 slot = (sk.topCount < sk.topK) ? sk.topCount++ : sk.topMinIdx;
+    sk.top[slot].key = key;
+    sk.top[slot].count = target;
+    if (sk.topCount == sk.topK) {
+        sketchFindTopMin(sk);
+    }
+}
+
+// Largest overestimate that holds with probability 1 - e^-depth
+UINT64 sketchErrorBound(const countMinSketch& sk) {
+    return (UINT64)std::ceil(std::exp(1.0) / sk.width * sk.total);
+}
+
+bool heavyHitterGreater(const heavyHitter& a, const heavyHitter& b) {
+    return a.count > b.count;
+}
+
+// keyShift scales keys back for printing (e.g. cache lines to byte addresses)
+VOID sketchReport(std::ostream& out, const countMinSketch& sk, UINT32 keyShift) {
+    UINT64 bound = sketchErrorBound(sk);
+    out << sk.name << ": total " << sk.total << ", " << sketchBytes(sk) / 1024 << "KB ("
+        << SKETCH_DEPTH << " x " << sk.width << "), overestimate at most " << bound
+        << " with probability " << 1.0 - std::exp(-(double)SKETCH_DEPTH) << std::endl;
+
+    vector<heavyHitter> top(sk.top, sk.top + sk.topCount);
+    for (UINT32 i = 0; i < top.size(); i++) {
+        top[i].count = sketchEstimate(sk, top[i].key);
+    }
+    std::sort(top.begin(), top.end(), heavyHitterGreater);
+    for (UINT32 i = 0; i < top.size(); i++) {
+        UINT64 low = top[i].count > bound ? top[i].count - bound : 0;
+        out << "  0x" << std::hex << (top[i].key << keyShift) << std::dec << " " << top[i].count
+            << " (true count in [" << low << ", " << top[i].count << "])" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+// Layout of the live statistics file shared between RobScan and RobScanMonitor.
+// The tool maps the file and republishes every interval; readers take consistent
+// snapshots with a seqlock (sequence is odd while a write is in progress).
+// Plain fixed-width types so it builds with or without Pin.
+#ifndef STATS_SHM_H
+#define STATS_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define ROBSTATS_MAGIC 0x53424F52
+#define ROBSTATS_VERSION 2
+#define ROBSTATS_MAX_THREADS 64
+
+struct robStatsShm {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence;
+    uint64_t pid;
+    uint64_t publishCount;
+    // Set by the final publish from Fini
+    uint32_t done;
+    uint32_t threadCount;
+    // Set when the ROB is flushed on mispredicts (-bp_flush)
+    uint32_t bpFlush;
+    uint32_t pad;
+
+    uint64_t iCount;
+    uint64_t forwardCount;
+    uint64_t missCount;
+    uint64_t regForwardCount;
+    uint64_t memForwardCount;
+    uint64_t branchCount;
+    uint64_t mispredictCount;
+    uint64_t stlfCount;
+
+    // Over the last publish interval
+    uint64_t intervalInsCount;
+    double intervalForwardRate;
+    double intervalMissRate;
+
+    uint64_t threadInsCount[ROBSTATS_MAX_THREADS];
+};
+
+inline void statsBeginWrite(robStatsShm* shm) {
+    __atomic_store_n(&shm->sequence, shm->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+inline void statsEndWrite(robStatsShm* shm) {
+    __atomic_store_n(&shm->sequence, shm->sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Copy a consistent snapshot; false if the writer kept it busy for too many tries
+inline bool statsReadSnapshot(const robStatsShm* shm, robStatsShm* out) {
+    for (int tries = 0; tries < 1000; tries++) {
+        uint64_t before = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(out, (const void*)shm, sizeof(robStatsShm));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
@@ -3,4 +3,4 @@
 
 cd /home/wxn6660/CE456
 source /project/extra/pin/3.13/enable
-pin -t RobScan.so -- ./matmul256
+pin -t RobScan.so -stats RobScan.stats -- ./matmul256